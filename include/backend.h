@@ -0,0 +1,53 @@
+#ifndef BACKEND_H_
+#define BACKEND_H_
+
+#include "simulator.h"
+
+/* The backends that run the protocols in real time instead of in the */
+/* simulator share the options, layer-5 arrivals, timers, simulator   */
+/* API and report below.  Each backend only moves packets between A   */
+/* and B, and drives run_deadlines() and the receiving side.          */
+
+#define   A    0
+#define   B    1
+
+/* what travels between A and B */
+struct wire {
+   int flow;
+   struct pkt pkt;
+   double due;             /* time it may be delivered, if the backend delays it */
+};
+
+struct flow {
+   int    application;     /* msgs passed from layer 5 to A */
+   int    queued;          /* msgs accepted by A but not yet sent */
+   double deadline[3];     /* timer of A and B and next arrival, <0 if none */
+   int    msglen;          /* bytes in the next msg from layer 5 */
+};
+
+/* counts and the current flow are kept by each thread */
+extern thread_local int A_application, A_transport, B_application, B_transport;
+extern thread_local int ntolayer3, nlost, ncorrupt;
+extern thread_local int nfull; /* packets the transport had no room for */
+extern thread_local int cur_flow;
+extern int TRACE, nsim, nsimmax, ndropped;
+extern int nflows;
+extern double usec_per_unit;
+extern struct flow *flows;
+
+/* provided by the backend: pass packet w from entity AorB to the other */
+void send_packet(int AorB, struct wire *w);
+
+void setup(int argc, char **argv); /* parse the options, call A_init() and B_init() */
+void start_clock();        /* time 0 is now */
+void start_arrivals();     /* schedule the first msg of every flow */
+void seed_random(int AorB); /* separate random numbers for entity AorB */
+
+double now();              /* time units since time 0 */
+double next_deadline();    /* earliest timer or arrival, <0 if none */
+void run_deadlines();      /* fire the timers and arrivals that are due */
+int finished();            /* every msg has been delivered or dropped */
+int out_of_time();         /* the run has gone on past its time limit, -D */
+void report(double elapsed);
+
+#endif
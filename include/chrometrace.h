@@ -0,0 +1,36 @@
+#ifndef CHROMETRACE_H_
+#define CHROMETRACE_H_
+
+/* Export of a run as Chrome trace-event JSON (-X File), which        */
+/* chrome://tracing and Perfetto open.  Each flow is a process with   */
+/* tracks for A, B and the two directions of the network; a time unit */
+/* is shown as a millisecond.  Msgs, packets and timers are async     */
+/* spans:                                                             */
+/*   msg      from layer 5 of A to layer 5 of B, split into the time   */
+/*            queued at A, held up by losses (waiting for a resend or  */
+/*            in B's buffer behind a lost packet) and crossing the     */
+/*            network; dropped msgs end at once                        */
+/*   data/ack from tolayer3() to arrival, loss or a bottleneck drop,   */
+/*            marked where they are corrupted                          */
+/*   timer    from starting to going off or being stopped, for the     */
+/*            timer of starttimer() and the logical timers alike       */
+int   ct_open(const char *path, int nflows);   /* 0 on success */
+void  ct_close();
+int   ct_enabled();
+
+void  ct_msg_begin(int flow, int n, float t);
+void  ct_msg_dropped(int flow, int n, float t);
+/* msg n delivered at time t: from layer 5 at from, first sent at sent, */
+/* and the copy that got it across sent at copy                         */
+void  ct_msg_end(int flow, int n, float from, float sent, float copy, float t);
+
+/* packets sent by AorB; ids are returned by ct_packet_begin() */
+long long ct_packet_begin(int flow, int AorB, int seqnum, int acknum, float t);
+void  ct_packet_mark(int flow, int AorB, long long id, const char *what, float t);
+void  ct_packet_end(int flow, int AorB, long long id, const char *fate, float t);
+
+/* timers of AorB: logical ones by their id, the other one as id -1 */
+void  ct_timer_begin(int flow, int AorB, int id, float t, float increment);
+void  ct_timer_end(int flow, int AorB, int id, const char *how, float t);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef COMMON_H_
+#define COMMON_H_
+
+#include "simulator.h"
+
+/* Shared by the simulator and the real-time backends: reading the     */
+/* options, and what the medium does to a packet handed to layer 3.    */
+/* Each program keeps its own globals; these only count into the ones  */
+/* below, which both define.                                           */
+extern thread_local int nlost, ncorrupt;
+extern int TRACE;
+
+int isNumber(char *input);
+int read_arg_int(char c);    /* optarg of -c as a number, exits if it is not one */
+float read_arg_float(char c); /* optarg of -c as a probability, exits if it is not one */
+
+/* parse the argument of -P into *rate and *burst, 0 on success */
+int parse_pacing(const char *spec, float *rate, int *burst);
+
+/* print the options every program takes, then the rest of its own */
+void display_usage(char *filename, const char *options);
+
+/* whether a packet is lost, with probability prob */
+int lose_packet(float prob);
+
+/* with probability prob, corrupt the payload, seqnum or acknum of p; */
+/* 1 if it was                                                        */
+int corrupt_packet(struct pkt *p, float prob);
+
+#endif
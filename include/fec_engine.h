@@ -0,0 +1,128 @@
+#ifndef FEC_ENGINE_H_
+#define FEC_ENGINE_H_
+
+#include "sr_engine.h"
+
+/* Selective Repeat with forward error correction.  Data packets are  */
+/* grouped in blocks of K by seqnum (1..K, K+1..2K, ...), and once the */
+/* last packet of a block is first sent the sender follows it with a   */
+/* parity packet: the XOR of the block's payloads.  B can then rebuild */
+/* any one packet lost or corrupted in a block without waiting for a   */
+/* timeout; it ACKs rebuilt packets like received ones, so A does not  */
+/* resend them.  Losses the parity can not cover fall back to SR.      */
+#define FEC_PARITY -1      /* acknum of a parity packet; seqnum is the block's last */
+
+template <int CAPACITY, int PAYLOAD, typename Seq, int K>
+struct fec_sender : sr_sender<CAPACITY, PAYLOAD, Seq> {
+  static_assert(K > 1 && K <= 64, "blocks are 2 to 64 packets");
+
+  char parity[PAYLOAD_SIZE] = {}; //XOR of the block's payloads so far
+
+  fec_sender(int w) : sr_sender<CAPACITY, PAYLOAD, Seq>(w) {}
+
+  void sent_new(const struct pkt &p){
+    struct pkt repair;
+
+    for (int i = 0; i < PAYLOAD; i++){
+      parity[i] ^= p.payload[i];
+    }
+    if ((Seq)(p.seqnum - 1) % K != K-1){
+      return;
+    }
+    repair.seqnum = p.seqnum;
+    repair.acknum = FEC_PARITY;
+    memcpy(repair.payload, parity, PAYLOAD_SIZE);
+    repair.checksum = rdt_checksum(repair);
+    tolayer3(0, repair);
+    memset(parity, 0, PAYLOAD_SIZE);
+  }
+};
+
+template <int CAPACITY, int PAYLOAD, typename Seq, int K>
+struct fec_receiver : sr_receiver<CAPACITY, PAYLOAD, Seq> {
+  typedef sr_receiver<CAPACITY, PAYLOAD, Seq> sr;
+
+  //What has arrived of a block
+  struct block {
+    Seq first; //Seqnum of its first packet
+    uint64_t received; //Bit i for packet first+i
+    bool have_parity;
+    char parity[PAYLOAD_SIZE]; //XOR of the parity and the packets received
+  };
+  window_slots <struct block, CAPACITY> blocks; //By the seqnum of their first packet
+
+  fec_receiver(int w) : sr(w){
+    int capacity = CAPACITY ? CAPACITY : capacity_for(2*w);
+
+    blocks.init(capacity);
+    for (int i = 0; i < capacity; i++){
+      blocks[i].first = 0; //No block starts at 0
+    }
+  }
+
+  //The block seq belongs to, emptied if its slot held an older one
+  struct block &block_of(Seq seq){
+    Seq first = seq - (Seq)(seq - 1) % K;
+    struct block &b = blocks[first];
+
+    if (b.first != first){
+      b.first = first;
+      b.received = 0;
+      b.have_parity = false;
+      memset(b.parity, 0, PAYLOAD_SIZE);
+    }
+    return b;
+  }
+
+  void add(struct block &b, const char *payload){
+    for (int i = 0; i < PAYLOAD; i++){
+      b.parity[i] ^= payload[i];
+    }
+  }
+
+  void input(struct pkt packet){
+    if (rdt_corrupt(packet)){
+      return;
+    }
+    //Only blocks that are still within reach of the window are tracked
+    Seq seq = packet.seqnum;
+    if ((Seq)(seq - sr::recv_base + sr::recv_window) >= 2*sr::recv_window){
+      if (packet.acknum != FEC_PARITY){
+        sr::input(packet);
+      }
+      return;
+    }
+
+    struct block &b = block_of(seq);
+    if (packet.acknum == FEC_PARITY){
+      if (b.have_parity){
+        return;
+      }
+      b.have_parity = true;
+      add(b, packet.payload);
+    }
+    else{
+      uint64_t bit = (uint64_t)1 << (Seq)(seq - b.first);
+      if (!(b.received & bit)){
+        b.received |= bit;
+        add(b, packet.payload);
+      }
+      sr::input(packet);
+    }
+
+    //Exactly one packet missing and the parity here: rebuild it
+    if (b.have_parity && __builtin_popcountll(b.received) == K-1){
+      int missing = __builtin_ctzll(~b.received);
+      struct pkt rebuilt;
+
+      rebuilt.seqnum = (Seq)(b.first + missing);
+      rebuilt.acknum = rebuilt.seqnum;
+      memcpy(rebuilt.payload, b.parity, PAYLOAD_SIZE);
+      rebuilt.checksum = rdt_checksum(rebuilt);
+      b.received |= (uint64_t)1 << missing;
+      sr::input(rebuilt);
+    }
+  }
+};
+
+#endif
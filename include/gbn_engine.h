@@ -0,0 +1,208 @@
+#ifndef GBN_ENGINE_H_
+#define GBN_ENGINE_H_
+
+#include <deque>
+
+#include "rdt_engine.h"
+
+/* Go-Back-N sender and receiver.  The packets in the window live in  */
+/* a ring of CAPACITY slots; msgs that do not fit in the window wait   */
+/* in a queue until acknowledgements make room.  Packets of the window */
+/* go on the wire from next_out on as fast as the pacer lets them, and */
+/* with congestion control only as far as the congestion window.       */
+#define GBN_RTT 10
+#define GBN_BASE_RTT 18
+
+template <int CAPACITY, int PAYLOAD, typename Seq>
+struct gbn_sender : rdt_sender {
+  static_assert((CAPACITY & (CAPACITY-1)) == 0, "capacity must be a power of two");
+  static_assert(PAYLOAD > 0 && PAYLOAD <= PAYLOAD_SIZE, "payload does not fit in a packet");
+
+  Seq send_base = 1; //Seq no of first packet in sender's window
+  Seq unsent = 1; //Seq num of first packet not sent yet
+  Seq next_out = 1; //Seq num of next packet in the window to put on the wire
+  Seq fresh = 1; //Seq num of first packet never put on the wire
+  Seq window; //Window size of sender
+  window_slots <struct pkt, CAPACITY> sent_dataPkt; //Packets in the window, by seqnum
+  window_slots <float, CAPACITY> first_sent; //Time each packet went on the wire, or -1 once resent
+  std::deque <struct pkt> buffered; //Packets waiting for room in the window, not numbered yet
+  token_bucket pacer;
+  congestion_window cc;
+  float base_timer = base_timeout(GBN_BASE_RTT); //Timeout to start from and go back to
+  float start_time, end_time, timer_fin = base_timer;
+
+  gbn_sender(int w) : window(w), cc(w){
+    sent_dataPkt.init(CAPACITY ? CAPACITY : capacity_for(w));
+    first_sent.init(CAPACITY ? CAPACITY : capacity_for(w));
+  }
+
+  //Packets that may be in flight: the window, or less under congestion control
+  Seq limit() { return cc.size(window); }
+
+  //Packet seq is in the window, one compare for both ends
+  bool in_window(Seq seq) { return (Seq)(seq - send_base) < limit(); }
+
+  //Packets per time unit to pace at: as configured, or a window per RTT
+  float pace_rate(){
+    float rate = get_pace_rate();
+
+    return rate == PACE_RTT ? limit() / timer_fin : rate;
+  }
+
+  //Put the packets of the window on the wire, as far as the pacer allows
+  void drain(){
+    float rate = pace_rate();
+
+    while (next_out != unsent && in_window(next_out) && pacer.take(rate)){
+      tolayer3(0, sent_dataPkt[next_out]);
+      if (next_out == fresh){
+        first_sent[next_out] = get_sim_time();
+        msg_sent(0);
+        fresh++;
+      }
+      else{
+        first_sent[next_out] = -1;
+      }
+      next_out++;
+    }
+  }
+
+  //Number packet p, the next one in the window, and send it
+  void send(struct pkt &p){
+    p.seqnum = unsent;
+    p.acknum = unsent;
+    p.checksum = rdt_checksum(p);
+    sent_dataPkt[unsent] = p;
+    unsent++;
+    drain();
+  }
+
+  //Update timer based on new_rtt only if new_rtt is more than base RTT - to ignore quick ACK's for retransmissions
+  void update_timer(){
+    end_time = get_sim_time();
+    float new_rtt = end_time - start_time;
+    if (new_rtt > GBN_RTT){
+      float new_timer = (0.875 * timer_fin) + (0.125 * new_rtt);
+      if (new_timer > GBN_RTT && new_timer < 2*base_timer){
+        timer_fin = new_timer;
+      }
+    }
+  }
+
+  void output(struct msg message){
+    struct pkt p;
+
+    copy_payload<PAYLOAD>(p.payload, message.data);
+
+    //Send when packet is within sender window, else buffer
+    if (buffered.empty() && in_window(unsent)){
+      send(p);
+      if (send_base == (Seq)(unsent-1)){
+        start_time = get_sim_time();
+        starttimer(0, cc.rto(timer_fin));
+      }
+    }
+    else{
+      buffered.push_back(p);
+    }
+  }
+
+  void input(struct pkt packet){
+    if (rdt_corrupt(packet)){
+      return;
+    }
+
+    //ACK for a packet that is already acknowledged: restart timer
+    if ((Seq)(packet.acknum - send_base) >= (Seq)(unsent - send_base)){
+      cc.dupack(timer_fin);
+      stoptimer(0);
+      starttimer(0, cc.rto(timer_fin));
+      return;
+    }
+    if (first_sent[packet.acknum] >= 0){
+      cc.sample(get_sim_time() - first_sent[packet.acknum]);
+    }
+    cc.acked((Seq)(packet.acknum + 1 - send_base));
+    cc.moved();
+    send_base = packet.acknum + 1;
+    if ((Seq)(next_out - send_base) > (Seq)(unsent - send_base)){
+      next_out = send_base; //ACKed past what was resent so far
+    }
+
+    if (send_base == unsent && buffered.empty()){
+      stoptimer(0);
+      update_timer();
+      return;
+    }
+    stoptimer(0);
+    starttimer(0, cc.rto(timer_fin));
+    update_timer();
+
+    //Send any buffered messages that fall into the new sender window
+    while (!buffered.empty() && in_window(unsent)){
+      send(buffered.front());
+      buffered.pop_front();
+    }
+    drain();
+  }
+
+  void timerinterrupt(){
+    cc.timeout(timer_fin);
+    timer_fin = base_timer;
+    starttimer(0, cc.rto(timer_fin));
+    //Resend every packet sent in the window
+    next_out = send_base;
+    drain();
+  }
+
+  void timerinterrupt_id(int id){
+    if (pacer.expired(id)){
+      drain();
+    }
+  }
+
+  void probe(struct probe *p){
+    p->window = limit();
+    p->inflight = (Seq)(fresh - send_base);
+    p->timeout = cc.rto(timer_fin);
+    p->send_base = send_base;
+  }
+};
+
+template <int PAYLOAD, typename Seq>
+struct gbn_receiver : rdt_receiver {
+  Seq expectedseqnum = 1; //Expected Seq no of next packet received from A
+  struct pkt sent_ackPkt; //Copy of last ACK sent to A
+
+  gbn_receiver(){
+    //Initialize ACK0
+    sent_ackPkt.seqnum = (Seq)(expectedseqnum - 1);
+    sent_ackPkt.acknum = (Seq)(expectedseqnum - 1);
+    memset(sent_ackPkt.payload, '\0', PAYLOAD_SIZE);
+    sent_ackPkt.checksum = rdt_checksum(sent_ackPkt);
+  }
+
+  void input(struct pkt packet){
+    char data_fromA[PAYLOAD_SIZE];
+
+    //In case of out of order delivery, discard packet and resend last ACK
+    if (rdt_corrupt(packet) || (Seq)packet.seqnum != expectedseqnum){
+      tolayer3(1, sent_ackPkt);
+      return;
+    }
+
+    copy_payload<PAYLOAD>(data_fromA, packet.payload);
+    tolayer5(1, data_fromA);
+
+    sent_ackPkt.seqnum = expectedseqnum;
+    sent_ackPkt.acknum = expectedseqnum;
+    memset(sent_ackPkt.payload, '\0', PAYLOAD_SIZE);
+    sent_ackPkt.checksum = rdt_checksum(sent_ackPkt);
+    tolayer3(1, sent_ackPkt);
+    expectedseqnum++;
+  }
+
+  void probe(struct probe *p) { p->recv_base = expectedseqnum; }
+};
+
+#endif
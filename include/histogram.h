@@ -0,0 +1,24 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+/* HDR-style histogram of non-negative values.  Values are counted in */
+/* units of HIST_UNIT; below 2^HIST_SUBBITS units every unit has its   */
+/* own bucket, and above that buckets keep HIST_SUBBITS significant   */
+/* bits, so a value is recorded to within 1 part in 2^(HIST_SUBBITS-1) */
+/* whatever its size.                                                 */
+#define HIST_SUBBITS 11
+#define HIST_UNIT 0.001
+
+struct histogram {
+   long long *counts;      /* values in each bucket */
+   int   nbuckets;         /* size of counts */
+   long long total;        /* values recorded */
+   double max;             /* largest value recorded */
+};
+
+void hist_record(struct histogram *h, double v);
+void hist_merge(struct histogram *to, struct histogram *from);
+/* smallest value that p percent of the values are at or below */
+double hist_percentile(struct histogram *h, double p);
+
+#endif
@@ -0,0 +1,316 @@
+#ifndef RDT_ENGINE_H_
+#define RDT_ENGINE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "simulator.h"
+
+/* Protocol engines: the sender and receiver of one flow, as objects  */
+/* so that a protocol can pick, per flow, an engine specialised at    */
+/* compile time for its window or one sized at run time.  Engines are */
+/* templates on                                                       */
+/*   CAPACITY  slots for seqnums, a power of two, or 0 for run time   */
+/*   PAYLOAD   bytes of the 20-byte payload carried from layer 5      */
+/*   Seq       unsigned type seqnums are kept in; they wrap around,   */
+/*             so it only needs to be wider than the capacity         */
+struct rdt_sender {
+  virtual ~rdt_sender() {}
+  virtual void output(struct msg message) = 0;
+  virtual void input(struct pkt packet) = 0;
+  virtual void timerinterrupt() = 0;
+  virtual void timerinterrupt_id(int id) {}
+  virtual void probe(struct probe *p) {}
+};
+
+struct rdt_receiver {
+  virtual ~rdt_receiver() {}
+  virtual void input(struct pkt packet) = 0;
+  virtual void probe(struct probe *p) {}
+};
+
+#define PAYLOAD_SIZE ((int)sizeof(((struct pkt *)0)->payload))
+
+//Slots for a window of seqnums, indexed by seqnum modulo the capacity
+template <typename T, int CAPACITY>
+struct window_slots {
+  T slot[CAPACITY];
+
+  void init(int capacity) {}
+  T &operator[](unsigned seq) { return slot[seq & (CAPACITY-1)]; }
+};
+
+//The same with the capacity chosen at run time
+template <typename T>
+struct window_slots<T, 0> {
+  std::vector <T> slot;
+  unsigned mask;
+
+  void init(int capacity) { slot.resize(capacity); mask = capacity-1; }
+  T &operator[](unsigned seq) { return slot[seq & mask]; }
+};
+
+//One bit per seqnum in a ring of at least CAPACITY bits, kept in 64-bit
+//words so that runs of set bits are found a word at a time
+template <int CAPACITY>
+struct window_bits_store {
+  enum { NBITS = CAPACITY > 64 ? CAPACITY : 64 };
+  uint64_t word[NBITS/64] = {};
+
+  void init(int capacity) {}
+  unsigned nbits() { return NBITS; }
+};
+
+template <>
+struct window_bits_store<0> {
+  std::vector <uint64_t> word;
+
+  void init(int capacity) { word.assign((capacity > 64 ? capacity : 64)/64, 0); }
+  unsigned nbits() { return word.size()*64; }
+};
+
+template <int CAPACITY>
+struct window_bits : window_bits_store<CAPACITY> {
+  using window_bits_store<CAPACITY>::word;
+  using window_bits_store<CAPACITY>::nbits;
+
+  void set(unsigned seq) { seq &= nbits()-1; word[seq >> 6] |= (uint64_t)1 << (seq & 63); }
+  bool test(unsigned seq) { seq &= nbits()-1; return word[seq >> 6] >> (seq & 63) & 1; }
+
+  //Number of set bits in a row from seq on, at most max
+  unsigned ones(unsigned seq, unsigned max){
+    unsigned n = 0;
+
+    while (n < max){
+      unsigned i = (seq + n) & (nbits()-1);
+      unsigned left = 64 - (i & 63);
+      uint64_t unset = ~word[i >> 6] >> (i & 63);
+      unsigned k = unset ? __builtin_ctzll(unset) : left;
+      n += k;
+      if (k < left){
+        break;
+      }
+    }
+    return n < max ? n : max;
+  }
+
+  //Clear n bits from seq on
+  void clear(unsigned seq, unsigned n){
+    while (n > 0){
+      unsigned i = seq & (nbits()-1);
+      unsigned k = 64 - (i & 63) < n ? 64 - (i & 63) : n;
+      uint64_t bits = k == 64 ? ~(uint64_t)0 : (((uint64_t)1 << k) - 1) << (i & 63);
+      word[i >> 6] &= ~bits;
+      seq += k;
+      n -= k;
+    }
+  }
+};
+
+//Token bucket pacing A's packets: it holds at most burst tokens and
+//gains rate of them per time unit, and a new packet goes out only
+//when it can take one.  Senders wait for the next token on a logical
+//timer, and when that goes off the token is theirs even if rounding
+//left the bucket a hair short.
+struct token_bucket {
+  float tokens = get_pace_burst();
+  float last = 0; //Time the tokens were last counted
+  int timer = -1; //Id of the timer running until the next token, or -1
+  bool due = false; //That timer has gone off
+
+  void refill(float rate){
+    float now = get_sim_time();
+
+    tokens += (now - last) * rate;
+    if (tokens > get_pace_burst()){
+      tokens = get_pace_burst();
+    }
+    last = now;
+  }
+
+  //Take a token for a new packet, if there is one; always when not pacing
+  bool take(float rate){
+    if (rate <= 0){
+      return true;
+    }
+    refill(rate);
+    if (tokens < 1 && !due){
+      if (timer < 0){
+        timer = starttimer_id(0, (1 - tokens) / rate);
+      }
+      return false;
+    }
+    tokens--;
+    due = false;
+    return true;
+  }
+
+  //Count a packet that goes out anyway, such as a retransmission
+  void charge(float rate){
+    if (rate > 0){
+      refill(rate);
+      tokens--;
+    }
+  }
+
+  //Timer id went off: whether it was the one waiting for a token
+  bool expired(int id){
+    if (id != timer){
+      return false;
+    }
+    timer = -1;
+    due = true;
+    return true;
+  }
+};
+
+//AIMD congestion window for -C aimd, in packets and capped at the -w
+//window.  It starts at one packet and grows by one per packet ACKed up
+//to ssthresh (slow start), then by one per window ACKed.  Three
+//duplicate ACKs or a NACK halve it; a timeout halves ssthresh and
+//starts over at one packet.  It is cut at most once per RTT, as one
+//loss often sends several signals.  Spurious timeouts would keep the
+//window small, so it keeps its own RTT estimate from packets sent
+//once, and its own timeout, doubled after each one that goes off.
+struct congestion_window {
+  bool on = get_congestion_control() == CC_AIMD;
+  float cwnd = 1;
+  float ssthresh, cap;
+  int dupacks = 0; //Duplicate ACKs since the window last moved
+  bool cut = false; //It has been cut, at time cut_at
+  float cut_at = 0;
+  float srtt = 0, rttvar = 0; //Smoothed RTT and its variation, 0 before a sample
+  int backoff = 1; //Timeouts in a row, as a factor on the timeout
+
+  congestion_window(int w) : ssthresh(w), cap(w) { changed(); }
+
+  //Packets the sender may have in flight with window w
+  unsigned size(unsigned w) { return on ? (unsigned)cwnd : w; }
+
+  //Timeout to use instead of the sender's own, fallback
+  float rto(float fallback){
+    if (!on){
+      return fallback;
+    }
+    return (srtt > 0 ? srtt + 4 * rttvar : fallback) * backoff;
+  }
+
+  //RTT measured on a packet that was sent only once
+  void sample(float rtt){
+    if (srtt == 0){
+      srtt = rtt;
+      rttvar = rtt / 2;
+    }
+    else{
+      rttvar = 0.75 * rttvar + 0.25 * (srtt > rtt ? srtt - rtt : rtt - srtt);
+      srtt = 0.875 * srtt + 0.125 * rtt;
+    }
+  }
+
+  void changed(){
+    if (on){
+      window_changed(0, cwnd);
+    }
+  }
+
+  //n more packets ACKed
+  void acked(int n){
+    if (!on){
+      return;
+    }
+    backoff = 1;
+    for (; n > 0 && cwnd < cap; n--){
+      cwnd += cwnd < ssthresh ? 1 : 1 / cwnd;
+    }
+    if (cwnd > cap){
+      cwnd = cap;
+    }
+    changed();
+  }
+
+  //The window moved on
+  void moved() { dupacks = 0; }
+
+  //Whether a loss signal may cut the window, an RTT after the last cut
+  bool may_cut(float fallback){
+    float now = get_sim_time();
+
+    if (cut && now - cut_at < (srtt > 0 ? srtt : fallback)){
+      return false;
+    }
+    cut = true;
+    cut_at = now;
+    dupacks = 0;
+    ssthresh = cwnd / 2 < 1 ? 1 : cwnd / 2;
+    return true;
+  }
+
+  //A packet was lost, as told by duplicate ACKs or a NACK
+  void lost(float fallback){
+    if (on && may_cut(fallback)){
+      cwnd = ssthresh;
+      changed();
+    }
+  }
+
+  void dupack(float fallback){
+    if (on && ++dupacks >= 3){
+      lost(fallback);
+    }
+  }
+
+  void timeout(float fallback){
+    if (!on){
+      return;
+    }
+    if (backoff < 64){
+      backoff *= 2;
+    }
+    if (may_cut(fallback)){
+      cwnd = 1;
+      changed();
+    }
+  }
+};
+
+//Timeout a sender starts from and goes back to: -R, or the protocol's own
+static inline float base_timeout(float own){
+  float t = get_timeout();
+
+  return t > 0 ? t : own;
+}
+
+//Smallest power of two that is at least n
+static inline int capacity_for(int n){
+  int c = 1;
+
+  while (c < n){
+    c <<= 1;
+  }
+  return c;
+}
+
+static inline int rdt_checksum(const struct pkt &p){
+  int checksum = p.seqnum + p.acknum;
+
+  for (int i = 0; i < PAYLOAD_SIZE; i++){
+    checksum += p.payload[i];
+  }
+  return ~checksum;
+}
+
+static inline bool rdt_corrupt(const struct pkt &p){
+  return p.checksum != rdt_checksum(p);
+}
+
+//Copy PAYLOAD bytes of a message, NULs and all, and clear the rest
+template <int PAYLOAD>
+static inline void copy_payload(char *to, const char *from){
+  memcpy(to, from, PAYLOAD);
+  if (PAYLOAD < PAYLOAD_SIZE){
+    memset(to + PAYLOAD, '\0', PAYLOAD_SIZE - PAYLOAD);
+  }
+}
+
+#endif
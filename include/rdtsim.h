@@ -0,0 +1,58 @@
+#ifndef RDTSIM_H_
+#define RDTSIM_H_
+
+/* librdtsim: the simulator as a library, to run simulations in-process */
+/* rather than as a command per run.  rdtsim_run() is the command line  */
+/* run with the given protocol and the given values of -w, -l, -c, -t,  */
+/* -s, -m, -n and -R, without tracing, and returns the numbers the      */
+/* report would print.  Every run starts from scratch, so runs with the */
+/* same configuration give the same results.  The simulator keeps its   */
+/* state in globals: run one simulation at a time per process.          */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rdtsim_config {
+   const char *protocol;   /* "abt", "gbn", "sr" or "fec" */
+   int   window;           /* -w */
+   float loss;             /* -l */
+   float corrupt;          /* -c */
+   float lambda;           /* -t: average time between msgs from layer 5 */
+   int   seed;             /* -s */
+   int   nmsgs;            /* -m */
+   int   nflows;           /* -n, 0 for one flow */
+   float timeout;          /* -R, 0 for the protocol's own */
+};
+
+struct rdtsim_stats {
+   int   A_application;    /* msgs from layer 5 to A */
+   int   A_transport;      /* packets A passed to layer 3 */
+   int   B_transport;      /* packets that arrived at B */
+   int   B_application;    /* msgs B passed to layer 5 */
+   float time;             /* simulated time at the end */
+   double throughput;      /* msgs delivered per time unit */
+   int   dropped;          /* msgs A discarded, its queue being full */
+   double avg_queue;       /* average msgs waiting at A */
+   int   max_queue;
+   double avg_queue_delay; /* average time msgs waited at A */
+   double max_queue_delay;
+   double avg_latency;     /* average time from layer 5 of A to layer 5 of B */
+   double overhead;        /* packets A sent per msg delivered */
+   double latency_p50, latency_p99, latency_max;
+   double fairness;        /* Jain's index over the flows' throughputs */
+};
+
+/* 0 on success, -1 if the configuration is not valid */
+int rdtsim_run(const struct rdtsim_config *config, struct rdtsim_stats *stats);
+
+/* n replications of abt, with seeds config->seed, config->seed+1 and */
+/* so on, run side by side in the lanes of a batch; stats[i] is what   */
+/* rdtsim_run() gives for seed config->seed+i.  0 on success, -1 if    */
+/* the configuration is not valid or not abt with one flow.            */
+int rdtsim_run_abt_batch(const struct rdtsim_config *config, int n, struct rdtsim_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <stdio.h>
+
+#include "simulator.h"
+
+/* Time series of the protocol's state, sampled every interval of     */
+/* simulated time (-S Interval:File), in a compact columnar file.      */
+/* The file starts with SAMPLE_MAGIC, the interval as a 4-byte float,  */
+/* the number of flows and the columns: name, whether it is per flow,  */
+/* and the scale its values were multiplied by.  Then come blocks of   */
+/* up to SAMPLE_BLOCK samples: the number of samples, and for every    */
+/* column the length in bytes of its values and the values.  Per-flow  */
+/* columns hold a value per flow for each sample, flow by flow.  Each  */
+/* value is the zigzag varint of its difference from the same flow's   */
+/* value one sample earlier in the block, so blocks decode on their    */
+/* own and a reader can skip the columns it does not want.             */
+#define SAMPLE_MAGIC "RDTSAMP1"
+#define SAMPLE_BLOCK 1024
+#define SAMPLE_SCALE 1000          /* timeouts are kept in thousandths */
+
+enum sample_column {
+   SC_SAMPLE,              /* number of the sample: it is at SC_SAMPLE * interval */
+   SC_EVENTS,              /* events and logical timers pending */
+   SC_WINDOW,              /* per flow from here on: see struct probe */
+   SC_INFLIGHT,
+   SC_TIMEOUT,
+   SC_SENDBASE,
+   SC_RECVBASE,
+   SC_DELIVERED,           /* msgs delivered to layer 5 of B so far */
+   NSCOLUMNS
+};
+#define SC_PERFLOW(c) ((c) >= SC_WINDOW)
+
+extern const char *sample_names[NSCOLUMNS];
+
+/* writing, from the simulator */
+int   sampler_open(const char *spec, int nflows);     /* 0 on success */
+float sampler_interval();
+void  sample_begin(long long k, int events);          /* then every flow in order */
+void  sample_flow(struct probe *p, int delivered);
+void  sampler_close();
+
+/* reading */
+struct sample_file {
+   FILE *f;
+   float interval;
+   int   nflows, ncols;
+   char  names[NSCOLUMNS][32];
+   int   perflow[NSCOLUMNS];
+   long long scale[NSCOLUMNS];
+   int   nsamples;         /* in the block read last */
+   long long *values[NSCOLUMNS]; /* its values, of the columns decoded */
+};
+
+int   sample_read_open(struct sample_file *sf, const char *path);   /* 0 on success */
+/* read the next block, decoding column c only if want[c] (all if want */
+/* is NULL); its number of samples, 0 at the end, -1 if it is damaged   */
+int   sample_read_block(struct sample_file *sf, const int *want);
+
+#endif
@@ -25,11 +25,24 @@ void A_output(struct msg message);
 void B_output(struct msg message);
 void A_input(struct pkt packet);
 void A_timerinterrupt();
+void A_timerinterrupt_id(int id);
 void A_init();
 
 void B_input(struct pkt packet);
 void B_init();
 
+/* State of a flow for the sampler (-S).  The simulator clears it and  */
+/* has A_probe() and B_probe() fill in what their entities keep.       */
+struct probe {
+   int   window;           /* packets A may have in flight */
+   int   inflight;         /* packets A has sent and not had ACKed */
+   float timeout;          /* A's current timeout */
+   int   send_base;        /* oldest seqnum A has not had ACKed */
+   int   recv_base;        /* seqnum B expects next */
+};
+void A_probe(struct probe *p);
+void B_probe(struct probe *p);
+
 /* Simulator API */
 void starttimer(int AorB, float increment);
 void stoptimer(int AorB);
@@ -38,4 +51,49 @@ void tolayer5(int AorB, char datasent[]);
 int getwinsize();
 float get_sim_time();
 
+/* Logical timers: an entity may run any number of them.  starttimer_id() */
+/* returns the id of the new timer, and when it goes off the simulator   */
+/* calls A_timerinterrupt_id() with that id.  They are independent of    */
+/* the timer of starttimer() and stoptimer().                             */
+int starttimer_id(int AorB, float increment);
+void stoptimer_id(int AorB, int id);
+
+/* Pacing (-P): average packets per time unit A's sender may send, 0  */
+/* for no pacing or PACE_RTT for a window per RTT, and the number it  */
+/* may send back to back                                              */
+#define PACE_RTT -1
+float get_pace_rate();
+int get_pace_burst();
+
+/* Congestion control (-C): CC_NONE to keep the window at getwinsize(), */
+/* or CC_AIMD to adapt it below that.  A sender that adapts its window  */
+/* tells the simulator each new size, for the report.                  */
+#define CC_NONE 0
+#define CC_AIMD 1
+int get_congestion_control();
+void window_changed(int AorB, float window);
+
+/* NACKs (-N): whether a receiver that sees a gap should ask for the   */
+/* missing packets at once rather than leave them to A's timers        */
+int get_nacks();
+
+/* Timeout (-R): the timeout A's sender starts from and goes back to   */
+/* when its timer goes off, or 0 for the protocol's own                */
+float get_timeout();
+
+/* Msg size (-M): bytes of every msg from layer 5 that carry data, 1  */
+/* to 20; the rest are NUL                                            */
+int get_msg_size();
+
+/* Flows: every flow runs its own copy of the protocol.  The simulator */
+/* calls A_init() and B_init() once per flow, and every routine is     */
+/* called with get_flow() set to the flow it is acting for.            */
+int get_flow();
+int get_num_flows();
+
+/* Sender queue accounting: called when a layer-5 message is handed to */
+/* layer 3 for the first time, or discarded because the queue is full  */
+void msg_sent(int AorB);
+void msg_dropped(int AorB);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef SINK_H_
+#define SINK_H_
+
+#include "simulator.h"
+
+/* A sink receives every msg B passes up to layer 5.  Sinks are        */
+/* selected by name with the -d option, e.g. "-d verify" or            */
+/* "-d file:out.bin"; anything after the ':' is passed to init().      */
+/* deliver() is told which msg from layer 5 of A the delivery should   */
+/* be, in order, or -1 if every msg was already delivered.  Flows may  */
+/* deliver from different threads, but each flow only from one.        */
+struct sink {
+   const char *name;
+   int   (*init)(const char *arg, int nflows);                 /* 0 on success */
+   void  (*deliver)(int flow, int msgno, const char *data);
+   void  (*report)();                                          /* after the run */
+};
+
+struct sink *find_sink(const char *spec);
+void list_sinks();
+
+/* provided by the simulator: msg number msgno of a flow, as A was given it */
+void make_msg(int flow, int msgno, struct msg *m);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include "backend.h"
+
+/* A single-producer single-consumer ring of packets that two processes */
+/* can share.  The producer owns tail and the consumer owns head; each   */
+/* keeps a copy of the other's index on its own cache line and only     */
+/* reads the real one when the copy says the ring is full or empty.     */
+#define RING_SIZE 65536    /* slots, a power of 2 */
+#define CACHELINE 64
+
+struct ring {
+   unsigned long tail __attribute__((aligned(CACHELINE))); /* next slot to fill */
+   unsigned long head_seen;                                 /* producer's copy of head */
+   unsigned long head __attribute__((aligned(CACHELINE))); /* next slot to empty */
+   unsigned long tail_seen;                                 /* consumer's copy of tail */
+   struct wire slots[RING_SIZE] __attribute__((aligned(CACHELINE)));
+};
+
+/* add packet w to the ring; 0 if it is full */
+static inline int ring_put(struct ring *r, const struct wire *w)
+{
+   unsigned long t = r->tail;
+
+   if (t - r->head_seen == RING_SIZE) {
+      r->head_seen = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+      if (t - r->head_seen == RING_SIZE)
+         return 0;
+   }
+   r->slots[t & (RING_SIZE-1)] = *w;
+   __atomic_store_n(&r->tail, t+1, __ATOMIC_RELEASE);
+   return 1;
+}
+
+/* take up to max packets from the ring into w; returns how many */
+static inline int ring_get(struct ring *r, struct wire *w, int max)
+{
+   unsigned long h = r->head;
+   int n = 0;
+
+   if (h == r->tail_seen) {
+      r->tail_seen = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+      if (h == r->tail_seen)
+         return 0;
+   }
+   while (n < max && h != r->tail_seen)
+      w[n++] = r->slots[h++ & (RING_SIZE-1)];
+   __atomic_store_n(&r->head, h, __ATOMIC_RELEASE);
+   return n;
+}
+
+/* oldest packet on the ring, left there; NULL if it is empty */
+static inline struct wire *ring_peek(struct ring *r)
+{
+   if (r->head == r->tail_seen) {
+      r->tail_seen = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+      if (r->head == r->tail_seen)
+         return NULL;
+   }
+   return &r->slots[r->head & (RING_SIZE-1)];
+}
+
+/* take the packet ring_peek() returned off the ring */
+static inline void ring_pop(struct ring *r)
+{
+   __atomic_store_n(&r->head, r->head+1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef SR_ENGINE_H_
+#define SR_ENGINE_H_
+
+#include <deque>
+#include <unordered_map>
+
+#include "rdt_engine.h"
+
+/* Selective Repeat sender and receiver.  The receiver keeps the ACKs  */
+/* of the window below its own for resending, so CAPACITY must be at   */
+/* least twice the window.  The sender runs a logical timer for every  */
+/* packet in flight, and resends just that packet when it goes off.    */
+/* Packets queue behind each other on the way to B, so each one's      */
+/* timeout is SR_DELAY longer for every packet in flight ahead of it.  */
+/* When its timer goes off and no packet sent after it has been ACKed, */
+/* the queue may be longer still: that allowance is doubled for it, up */
+/* to SR_MAX_BACKOFF times.  The other timers are left alone.          */
+/* New packets wait in the buffer for the pacer as well as for room in */
+/* the window; retransmissions go at once but use up tokens.  Under    */
+/* congestion control, ACKs beyond a gap count as duplicate ACKs.      */
+/* With -N the receiver NACKs the packets missing below one it buffers */
+/* out of order, each at most once every SR_NACK_GAP, and the sender   */
+/* resends a NACKed packet at once.  A NACK is an ACK packet whose     */
+/* seqnum is SR_NACK.                                                  */
+#define SR_RTT 10
+#define SR_BASE_RTT 12
+#define SR_DELAY 7
+#define SR_MAX_BACKOFF 8
+#define SR_NACK -1
+#define SR_NACK_GAP SR_BASE_RTT
+
+template <int CAPACITY, int PAYLOAD, typename Seq>
+struct sr_sender : rdt_sender {
+  static_assert((CAPACITY & (CAPACITY-1)) == 0, "capacity must be a power of two");
+  static_assert(PAYLOAD > 0 && PAYLOAD <= PAYLOAD_SIZE, "payload does not fit in a packet");
+
+  Seq send_base = 1; //Seq no of first packet in sender's window
+  Seq nextseqnum = 1; //Seq num of next packet that will be made
+  Seq unsent = 1; //Seq num of first packet not sent yet
+  Seq sender_window; //Window size of sender
+
+  window_slots <struct pkt, CAPACITY> sent_dataPkt; //Packets in the window, by seqnum
+  window_slots <int, CAPACITY> timer; //Id of the timer of each packet in flight
+  window_bits <CAPACITY> acked; //Packets in the window ACKed out of order
+  window_bits <CAPACITY> resent; //Packets in the window sent more than once
+  window_slots <float, CAPACITY> pkt_sent_timer; //Time each packet was last sent
+  window_slots <int, CAPACITY> backoff; //Factor on each packet's timeout
+  std::unordered_map <int, Seq> timed; //Packet each running timer is for
+  std::deque <struct pkt> buffered; //Packets waiting for room in the window or a token
+  token_bucket pacer;
+  congestion_window cc;
+  float base_timer = base_timeout(SR_BASE_RTT); //Timeout to start from
+  float end_time, timer_fin = base_timer;
+  float arrived_sent = -1; //Time the last packet known to have arrived was sent
+
+  sr_sender(int w) : sender_window(w), cc(w){
+    int capacity = CAPACITY ? CAPACITY : capacity_for(2*w);
+
+    sent_dataPkt.init(capacity);
+    timer.init(capacity);
+    acked.init(capacity);
+    resent.init(capacity);
+    pkt_sent_timer.init(capacity);
+    backoff.init(capacity);
+    timed.reserve(w);
+  }
+
+  //Packets that may be in flight: the window, or less under congestion control
+  Seq limit() { return cc.size(sender_window); }
+
+  bool in_window(Seq seq) { return (Seq)(seq - send_base) < limit(); }
+
+  //Packet seq has been sent and not ACKed yet
+  bool in_flight(Seq seq) { return (Seq)(seq - send_base) < (Seq)(unsent - send_base) && !acked.test(seq); }
+
+  //Called after a packet is sent for the first time, in seqnum order
+  virtual void sent_new(const struct pkt &p) {}
+
+  //Update timer based on new_rtt only if new_rtt is more than base RTT - to ignore quick ACK's for retransmissions
+  void update_timer(Seq seq){
+    end_time = get_sim_time();
+    float new_rtt = end_time - pkt_sent_timer[seq];
+    if (new_rtt > SR_RTT){
+      float new_timer = (0.875 * timer_fin) + (0.125 * new_rtt);
+      if (new_timer > SR_RTT && new_timer < 2*base_timer){
+        timer_fin = new_timer;
+      }
+    }
+  }
+
+  //Packets per time unit to pace at: as configured, or a window per RTT
+  float pace_rate(){
+    float rate = get_pace_rate();
+
+    return rate == PACE_RTT ? limit() / timer_fin : rate;
+  }
+
+  //Timeout of packet seq, sent now
+  float timeout(Seq seq){
+    if (cc.on){
+      return cc.rto(timer_fin);
+    }
+    return timer_fin + SR_DELAY * timed.size() * backoff[seq];
+  }
+
+  //Put packet seq on the wire and start its timer
+  void transmit(Seq seq){
+    tolayer3(0, sent_dataPkt[seq]);
+    pkt_sent_timer[seq] = get_sim_time();
+    timer[seq] = starttimer_id(0, timeout(seq));
+    timed[timer[seq]] = seq;
+  }
+
+  void send(struct pkt &p){
+    sent_dataPkt[p.seqnum] = p;
+    resent.clear(p.seqnum, 1);
+    backoff[p.seqnum] = 1;
+    unsent++;
+    transmit(p.seqnum);
+    msg_sent(0);
+    sent_new(p);
+  }
+
+  void output(struct msg message){
+    struct pkt p;
+
+    p.seqnum = nextseqnum;
+    p.acknum = nextseqnum;
+    copy_payload<PAYLOAD>(p.payload, message.data);
+    p.checksum = rdt_checksum(p);
+    nextseqnum++;
+    buffered.push_back(p);
+    drain();
+  }
+
+  //Send the buffered packets that the window and the pacer have room for
+  void drain(){
+    float rate = pace_rate();
+
+    while (!buffered.empty() && in_window(buffered.front().seqnum) && pacer.take(rate)){
+      send(buffered.front());
+      buffered.pop_front();
+    }
+  }
+
+  //Resend packet seq, which is in flight and whose timer is running
+  void resend(Seq seq){
+    pacer.charge(pace_rate());
+    resent.set(seq);
+    transmit(seq);
+  }
+
+  void input(struct pkt packet){
+    Seq acknum = packet.acknum;
+
+    //Corrupt, or ACK for a packet that is not in flight
+    if (rdt_corrupt(packet) || !in_flight(acknum)){
+      return;
+    }
+    if (packet.seqnum == SR_NACK){
+      stoptimer_id(0, timer[acknum]);
+      timed.erase(timer[acknum]);
+      cc.lost(timer_fin);
+      resend(acknum);
+      return;
+    }
+    stoptimer_id(0, timer[acknum]);
+    timed.erase(timer[acknum]);
+    update_timer(acknum);
+    if (pkt_sent_timer[acknum] > arrived_sent){
+      arrived_sent = pkt_sent_timer[acknum];
+    }
+    if (!resent.test(acknum)){
+      cc.sample(get_sim_time() - pkt_sent_timer[acknum]);
+    }
+    cc.acked(1);
+
+    if (acknum != send_base){
+      acked.set(acknum);
+      cc.dupack(timer_fin);
+      drain();
+      return;
+    }
+    cc.moved();
+
+    //ACK for the first packet in sender window: move the window,
+    //past packets whose ACK had already been received
+    ++send_base;
+    Seq n = acked.ones(send_base, (Seq)(unsent - send_base));
+    acked.clear(send_base, n);
+    send_base += n;
+
+    //Send any buffered messages that fall into the new sender window
+    drain();
+  }
+
+  //Every packet has a timer of its own
+  void timerinterrupt() {}
+
+  void timerinterrupt_id(int id){
+    typename std::unordered_map <int, Seq>::iterator t;
+
+    if (pacer.expired(id)){
+      drain();
+      return;
+    }
+    if ((t = timed.find(id)) == timed.end()){
+      return;
+    }
+    Seq seq = t->second;
+    timed.erase(t);
+    cc.timeout(timer_fin);
+    //A packet sent later has arrived, so this one was lost; otherwise
+    //it may still be queued, so give it longer next time
+    if (pkt_sent_timer[seq] < arrived_sent){
+      backoff[seq] = 1;
+    }
+    else if (backoff[seq] < SR_MAX_BACKOFF){
+      backoff[seq] *= 2;
+    }
+    resend(seq);
+  }
+
+  void probe(struct probe *p){
+    p->window = limit();
+    p->inflight = timed.size();
+    p->timeout = cc.rto(timer_fin);
+    p->send_base = send_base;
+  }
+};
+
+template <int CAPACITY, int PAYLOAD, typename Seq>
+struct sr_receiver : rdt_receiver {
+  static_assert((CAPACITY & (CAPACITY-1)) == 0, "capacity must be a power of two");
+
+  Seq recv_base = 1; //Seq no of first packet in receiver's window
+  Seq recv_window; //Window size of receiver
+  Seq history; //Seqnums below recv_base whose ACKs are still kept
+  window_slots <struct pkt, CAPACITY> sent_ackPkt; //ACKs sent to A, by seqnum
+  window_slots <struct pkt, CAPACITY> recv_dataPkt; //Packets received out of order
+  window_bits <CAPACITY> ack_pkts; //Packets buffered in recv_dataPkt
+  bool nacks = get_nacks();
+  struct nack {
+    Seq seq; //Packet last NACKed from this slot
+    float at; //When
+  };
+  window_slots <struct nack, CAPACITY> nacked;
+
+  sr_receiver(int w) : recv_window(w){
+    int capacity = CAPACITY ? CAPACITY : capacity_for(2*w);
+
+    history = capacity - w;
+    sent_ackPkt.init(capacity);
+    recv_dataPkt.init(capacity);
+    ack_pkts.init(capacity);
+    nacked.init(capacity);
+    for (int i = 0; i < capacity; i++){
+      nacked[i].seq = 0; //No packet is 0
+    }
+  }
+
+  //NACK the packets missing below seq, unless NACKed within SR_NACK_GAP
+  void nack_gaps(Seq seq){
+    float now = get_sim_time();
+    struct pkt p;
+
+    memset(p.payload, '\0', PAYLOAD_SIZE);
+    p.seqnum = SR_NACK;
+    for (Seq s = recv_base; s != seq; ){
+      //Skip the packets already buffered
+      s += ack_pkts.ones(s, (Seq)(seq - s));
+      if (s == seq){
+        break;
+      }
+      struct nack &n = nacked[s];
+      if (n.seq != s || now - n.at >= SR_NACK_GAP){
+        n.seq = s;
+        n.at = now;
+        p.acknum = s;
+        p.checksum = rdt_checksum(p);
+        tolayer3(1, p);
+      }
+      s++;
+    }
+  }
+
+  void deliver(const struct pkt &p){
+    char data_fromA[PAYLOAD_SIZE];
+
+    copy_payload<PAYLOAD>(data_fromA, p.payload);
+    tolayer5(1, data_fromA);
+  }
+
+  void input(struct pkt packet){
+    Seq seq = packet.seqnum;
+    struct pkt p_toLayer3;
+
+    if (rdt_corrupt(packet)){
+      return;
+    }
+
+    //Packet from before the window: resend its ACK
+    if ((Seq)(seq - recv_base) >= recv_window){
+      if ((Seq)(recv_base - seq - 1) < history){
+        tolayer3(1, sent_ackPkt[seq]);
+      }
+      return;
+    }
+
+    //Send data to layer 5 if seqnum is in order, with any buffered after it
+    if (seq == recv_base){
+      deliver(packet);
+      ++recv_base;
+      Seq n = ack_pkts.ones(recv_base, recv_window);
+      ack_pkts.clear(recv_base, n);
+      for (; n > 0; n--){
+        deliver(recv_dataPkt[recv_base]);
+        ++recv_base;
+      }
+    }
+    else{
+      recv_dataPkt[seq] = packet;
+      ack_pkts.set(seq);
+      if (nacks){
+        nack_gaps(seq);
+      }
+    }
+
+    //Send ACK to A for packet received
+    p_toLayer3.seqnum = seq;
+    p_toLayer3.acknum = seq;
+    memset(p_toLayer3.payload, '\0', PAYLOAD_SIZE);
+    p_toLayer3.checksum = rdt_checksum(p_toLayer3);
+    sent_ackPkt[seq] = p_toLayer3;
+    tolayer3(1, p_toLayer3);
+  }
+
+  void probe(struct probe *p) { p->recv_base = recv_base; }
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+/* Hierarchical timing wheel holding the logical timers of one event   */
+/* list.  Time is cut into ticks of 1/WHEEL_TICKS time units, and level */
+/* L has WHEEL_SLOTS slots of WHEEL_SLOTS^L ticks each.  A timer sits   */
+/* on the lowest level whose slot tells it apart from the wheel's       */
+/* current tick, so starting and stopping one is O(1); a higher slot is */
+/* spread over the levels below only once the wheel's tick reaches it.  */
+/* Timers further off than the top level wait on a list of their own.  */
+/* The ticks only place timers: each goes off at its exact time.        */
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_TICKS  16
+#define WHEEL_INDEXBITS 20         /* a timer id is its index in the pool and a generation above */
+
+struct wtimer {
+   float when;             /* time it goes off */
+   int   id;               /* handle it was started with, -1 if free */
+   int   gen;              /* times it has been started, so that old ids go stale */
+   int   flow, entity;     /* whose timer it is */
+   unsigned int seq;       /* start order, to break ties in when */
+   int   level, slot;      /* list it is on */
+   int   next, prev;       /* neighbours on the list, or next free timer; -1 at the ends */
+};
+
+struct wheel {
+   struct wtimer *timers;  /* the pool */
+   int   size;             /* size of the pool, 0 until a timer is started */
+   int   freelist;         /* first free timer, -1 if none */
+   int   count;            /* timers running */
+   unsigned int seq;       /* timers started so far */
+   long long now;          /* tick the timers are placed from */
+   unsigned long long occupied[WHEEL_LEVELS+1];  /* slots with timers, the far list as level WHEEL_LEVELS */
+   int   head[WHEEL_LEVELS+1][WHEEL_SLOTS];
+};
+
+/* start a timer going off at time when; returns its id */
+int   wheel_add(struct wheel *w, float when, int flow, int entity);
+/* stop timer id; 0 if it was not running */
+int   wheel_cancel(struct wheel *w, int id);
+/* time the wheel next has to be run: when the earliest timer goes off */
+/* or, while that is on a higher level, when its slot is reached;      */
+/* INFINITY if no timer is running                                     */
+float wheel_next(struct wheel *w);
+/* run the wheel up to time t and take the earliest timer off if it   */
+/* goes off by then; returns its id and owner, or -1 if none is due   */
+int   wheel_expire(struct wheel *w, float t, int *flow, int *entity);
+
+#endif
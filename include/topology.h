@@ -0,0 +1,58 @@
+#ifndef TOPOLOGY_H_
+#define TOPOLOGY_H_
+
+/* A topology is a set of nodes joined by one-way links.  A flow's A  */
+/* and B entities sit on nodes, and packets between them are stored  */
+/* and forwarded hop by hop along static routes.  Without a topology */
+/* file the simulator uses two nodes and one link in each direction. */
+struct link {
+   int   from, to;         /* nodes at each end */
+   float mindelay;         /* delay is uniform on [mindelay, mindelay+jitter] */
+   float jitter;
+   float lossprob;         /* probability that a packet is dropped */
+   float rate;             /* packets per time unit, 0 for no bottleneck */
+   int   qlimit;           /* bottleneck queue size, 0 for unlimited */
+   int   serial;           /* delay counts from the last arrival on the link */
+
+   float lastarrival;      /* latest arrival time of packets on the link */
+   float busyuntil;        /* time the bottleneck finishes its queue */
+   float *departures;      /* departure times of packets in the queue */
+   int   qhead, qlen;      /* oldest queued packet and number queued */
+   int   maxqlen;          /* largest queue seen */
+   int   nsent;            /* packets put on the link */
+   int   ndropped;         /* packets dropped at the bottleneck */
+};
+
+struct topology {
+   int   nnodes;
+   int   nlinks;
+   struct link *links;
+   int   *nexthop;         /* link to take from node n towards node d, */
+                           /* at [n*nnodes+d], or -1 if there is none   */
+   int   nflows;
+   int   *anode, *bnode;   /* node of A and B of each flow */
+};
+
+/*
+ * Topology file, one item per line ('#' starts a comment):
+ *   link U V DELAY LOSS RATE [QUEUE]   links U->V and V->U
+ *   route N D H                        from node N, reach node D via neighbour H
+ *   flow F A B                         A of flow F on node A, B on node B
+ *   flow * A B                         the same for every flow
+ * DELAY is either fixed or MIN:MAX, RATE is packets per time unit
+ * (0 for unlimited) and QUEUE is in packets (0 for unlimited).
+ * Nodes are numbered from 0.  Routes not given follow the fewest hops,
+ * and flows not given run from node 0 to the highest numbered node.
+ * Links keep packets in order.  The default medium also delays each
+ * packet from the last arrival on it (so it carries one packet at a
+ * time); links from a file delay packets from the time they leave the
+ * bottleneck, so several can be in flight.
+ */
+struct topology *load_topology(const char *file, int nflows);
+struct topology *default_topology(int nflows, float lossprob, float rate, int qlimit);
+void free_topology(struct topology *t);
+
+/* link to take from node n towards node d, NULL if unreachable */
+struct link *route(struct topology *t, int n, int d);
+
+#endif
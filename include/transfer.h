@@ -0,0 +1,24 @@
+#ifndef TRANSFER_H_
+#define TRANSFER_H_
+
+#include "workload.h"
+#include "sink.h"
+
+/* Bulk file transfer (-F In:Out): every flow sends the whole of file  */
+/* In, one 20-byte msg at a time and as fast as A takes them.  In is   */
+/* mapped into memory, and B writes each msg at its offset in a mapped */
+/* output file, Out (or Out.0, Out.1, ... when there are several       */
+/* flows).  The run ends once every flow has delivered all of In, or   */
+/* fails once A has sent TRANSFER_MAXSENT packets for every msg of it. */
+#define TRANSFER_MAXSENT 100
+
+extern struct workload transfer_workload;
+extern struct sink transfer_sink;
+
+int   transfer_open(const char *spec, int nflows);  /* 0 on success */
+void  transfer_fill(int flow, int msgno, struct msg *m);
+int   transfer_done();          /* every flow has delivered the whole file */
+long long transfer_bytes();     /* bytes delivered so far, over all flows */
+long long transfer_maxsent();   /* packets A may send before the run gives up */
+
+#endif
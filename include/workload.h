@@ -0,0 +1,24 @@
+#ifndef WORKLOAD_H_
+#define WORKLOAD_H_
+
+/* A workload generator decides when the next message is passed from    */
+/* layer 5 to A and how many bytes of it are used.  Generators are       */
+/* selected by name with the -a option, e.g. "-a poisson" or             */
+/* "-a trace:arrivals.txt"; anything after the ':' is passed to init().  */
+/* Every flow has its own independent arrival process.                   */
+struct workload {
+   const char *name;
+   int   (*init)(const char *arg, float lambda, int nflows); /* 0 on success */
+   float (*next_arrival)(int flow, float now, int *len);     /* time until next msg, <0 when done */
+   int   backlogged;    /* generate msgs only while A has nothing queued */
+};
+
+struct workload *find_workload(const char *spec);
+void set_lambda(float lambda);
+void set_msg_size(int size);     /* bytes in each msg, at most 20 */
+void list_workloads();
+
+/* provided by the simulator */
+float jimsrand();
+
+#endif
@@ -21,20 +21,35 @@ using namespace std;
 //Global Params
 #define RTT 10
 #define BASE_RTT 12
+#define QUEUE_SIZE 1000
+
+//Timeout to start from and go back to: -R, or BASE_RTT
+static float base_timer(){
+  return get_timeout() > 0 ? get_timeout() : BASE_RTT;
+}
 
 //Sender
-static int send_seq = -1; //Seq no of packet sent to B
-static int recv_ack = -1; //Ack num of last ACK received from B
-static struct pkt sent_dataPkt; // Copy of the last data packet sent to B
-static float start_time, end_time, timer_fin;
+struct sender{
+  int send_seq = -1; //Seq no of packet sent to B
+  int recv_ack = -1; //Ack num of last ACK received from B
+  struct pkt sent_dataPkt; // Copy of the last data packet sent to B
+  float start_time, end_time, timer_fin;
+  struct msg send_queue[QUEUE_SIZE]; // Messages waiting for the ACK of the packet in transit
+  int queue_head = 0; //Position of oldest message in send queue
+  int queue_len = 0; //Number of messages in send queue
+};
+static struct sender *senders = NULL; //Sender of each flow
 
 //Receiver
-static int recv_seq = -1; //Seq no of last packet received from A
-static int send_ack = -1; //Ack num of last ACK sent to A
-static struct pkt sent_ackPkt; // Copy of last ACK sent to A
+struct receiver{
+  int recv_seq = -1; //Seq no of last packet received from A
+  int send_ack = -1; //Ack num of last ACK sent to A
+  struct pkt sent_ackPkt = {}; // Copy of last ACK sent to A, none (so corrupt) to begin with
+};
+static struct receiver *receivers = NULL; //Receiver of each flow
 
 //Function to generate checksum
-int generate_checksum(struct pkt p){
+static int generate_checksum(struct pkt p){
   int checksum = 0;
 
   for (int i = 0; i < 20; i++){
@@ -48,7 +63,7 @@ int generate_checksum(struct pkt p){
 }
 
 //Function to verify checksum
-bool check_corrupt(struct pkt p){
+static bool check_corrupt(struct pkt p){
   int check = 0;
   check += p.seqnum;
   check += p.acknum;
@@ -69,64 +84,90 @@ bool check_corrupt(struct pkt p){
   }
 }
 
-/* called from layer 5, passed the data to be sent to other side */
-void A_output(struct msg message)
-{
-  //Ignore if ACK has not been received for last sent packet
-  if (send_seq != recv_ack){
-    //cout<<"A_output Packet in transit\n";    
-    return;
-  }
-  
+//Function to send message to layer 3 as the next data packet
+static void send_message(struct sender *s, struct msg message){
   //Create new pkt to send to layer 3
   struct pkt p_toLayer3;
   
-  send_seq = (send_seq+1)%2;
+  s->send_seq = (s->send_seq+1)%2;
   
-  p_toLayer3.seqnum = send_seq;
-  p_toLayer3.acknum = recv_ack;
-  strncpy(p_toLayer3.payload, message.data, 20);
+  p_toLayer3.seqnum = s->send_seq;
+  p_toLayer3.acknum = s->recv_ack;
+  memcpy(p_toLayer3.payload, message.data, 20);
   p_toLayer3.checksum = generate_checksum(p_toLayer3);  
-  sent_dataPkt = p_toLayer3;
-  start_time = get_sim_time();
+  s->sent_dataPkt = p_toLayer3;
+  s->start_time = get_sim_time();
   
-  //cout<<"A_output sent to layer 3, SEQ:"<<send_seq<<"Data:"<<message.data<<" Time:"<<get_sim_time()<<endl;
-  starttimer(0, timer_fin);
+  //cout<<"A_output sent to layer 3, SEQ:"<<s->send_seq<<"Data:"<<message.data<<" Time:"<<get_sim_time()<<endl;
+  starttimer(0, s->timer_fin);
   tolayer3(0, p_toLayer3);
+  msg_sent(0);
+}
+
+/* called from layer 5, passed the data to be sent to other side */
+void A_output(struct msg message)
+{
+  struct sender *s = &senders[get_flow()];
+  
+  //Queue message if ACK has not been received for last sent packet
+  if (s->send_seq != s->recv_ack){
+    //Drop message if send queue is full
+    if (s->queue_len == QUEUE_SIZE){
+      //cout<<"A_output Send queue full\n";
+      msg_dropped(0);
+      return;
+    }
+    //cout<<"A_output Packet in transit, message queued\n";
+    s->send_queue[(s->queue_head + s->queue_len) % QUEUE_SIZE] = message;
+    s->queue_len++;
+    return;
+  }
+  
+  send_message(s, message);
 }
 
 /* called from layer 3, when a packet arrives for layer 4 */
 void A_input(struct pkt packet)
 {
+  struct sender *s = &senders[get_flow()];
+  
   //cout<<"A_input ACK:"<<packet.acknum<<" received at time:"<<get_sim_time(); 
   
   //Check if ACK is corrupt, or duplicate ACK is received, then do nothing
-  if (check_corrupt(packet) || packet.acknum == recv_ack){
+  if (check_corrupt(packet) || packet.acknum == s->recv_ack){
     //cout<<"Inside A_input. ACK corrupt\n";    
     return;
   }
   
   //Check if  duplicate ACK is received, then do nothing  
-  if (packet.acknum == recv_ack){
+  if (packet.acknum == s->recv_ack){
     //cout<<"Inside A_input. Duplicate ACK\n";    
     return;
   }  
   
   //Check if expected ACK received and is not a duplicate
-  if (packet.acknum == send_seq && packet.acknum != recv_ack){
+  if (packet.acknum == s->send_seq && packet.acknum != s->recv_ack){
     //Update last received ACK number
-    recv_ack = send_seq; 
+    s->recv_ack = s->send_seq; 
     stoptimer(0);
     
     //Update timer based on new_rtt only if new_rtt is more than base RTT - to ignore quick ACK's for retransmissions
-    end_time = get_sim_time();
-    float new_rtt = end_time - start_time;
+    s->end_time = get_sim_time();
+    float new_rtt = s->end_time - s->start_time;
     if (new_rtt > RTT){
-      float new_timer = (0.875 * timer_fin) + (0.125 * new_rtt);
-      if (new_timer > RTT && new_timer < 2*BASE_RTT){
-        timer_fin = new_timer;
+      float new_timer = (0.875 * s->timer_fin) + (0.125 * new_rtt);
+      if (new_timer > RTT && new_timer < 2*base_timer()){
+        s->timer_fin = new_timer;
       }
-      //cout<<"Inside A_input. New RTT:"<<new_rtt<<" New timer set to:"<<timer_fin<<endl;
+      //cout<<"Inside A_input. New RTT:"<<new_rtt<<" New timer set to:"<<s->timer_fin<<endl;
+    }
+    
+    //Send next queued message, if any
+    if (s->queue_len > 0){
+      struct msg message = s->send_queue[s->queue_head];
+      s->queue_head = (s->queue_head+1) % QUEUE_SIZE;
+      s->queue_len--;
+      send_message(s, message);
     }
   }
 }
@@ -134,18 +175,42 @@ void A_input(struct pkt packet)
 /* called when A's timer goes off */
 void A_timerinterrupt()
 {
-  timer_fin = BASE_RTT;
-  //cout<<"A_timerinterrupt retransmitted to layer 3, SEQ:"<<send_seq<<" Data:"<<sent_dataPkt.payload<<" Time:"<<get_sim_time()<<endl;
-  starttimer(0, timer_fin);  
-  tolayer3(0, sent_dataPkt);
+  struct sender *s = &senders[get_flow()];
+  
+  s->timer_fin = base_timer();
+  //cout<<"A_timerinterrupt retransmitted to layer 3, SEQ:"<<s->send_seq<<" Data:"<<s->sent_dataPkt.payload<<" Time:"<<get_sim_time()<<endl;
+  starttimer(0, s->timer_fin);  
+  tolayer3(0, s->sent_dataPkt);
 }  
 
+/* called when one of A's logical timers goes off; ABT only runs its one timer */
+void A_timerinterrupt_id(int id)
+{
+}
+
+/* called by the sampler (-S) for the state of A; seqnums are the bit */
+void A_probe(struct probe *p)
+{
+  struct sender *s = &senders[get_flow()];
+
+  p->window = 1;
+  p->inflight = s->send_seq != s->recv_ack;
+  p->timeout = s->timer_fin;
+  p->send_base = s->send_seq;
+}
+
 /* the following routine will be called once (only) before any other */
 /* entity A routines are called. You can use it to do any initialization */
 void A_init()
 {
   //cout<<"Inside A_init\n";
-  timer_fin = BASE_RTT;
+  //Create senders for all flows when called for the first one
+  if (get_flow() == 0){
+    delete[] senders;
+    senders = new sender[get_num_flows()];
+  }
+  struct sender *s = &senders[get_flow()];
+  s->timer_fin = base_timer();
 }
 
 /* Note that with simplex transfer from a-to-B, there is no B_output() */
@@ -153,39 +218,46 @@ void A_init()
 /* called from layer 3, when a packet arrives for layer 4 at B*/
 void B_input(struct pkt packet)
 {
+  struct receiver *r = &receivers[get_flow()];
   struct pkt p_toLayer3;
   char data_fromA[20];
   
   //Check if packet is corrupt, then send prev ACK
   if (check_corrupt(packet)){
-    tolayer3(1, sent_ackPkt);
+    tolayer3(1, r->sent_ackPkt);
     return;    
   }
   
   //Resend ACK if duplicate packet is received
-  if (packet.seqnum == send_ack){
-    tolayer3(1, sent_ackPkt);
+  if (packet.seqnum == r->send_ack){
+    tolayer3(1, r->sent_ackPkt);
     return;
   }
   else{
-    send_ack = packet.seqnum;
-    recv_seq = (recv_seq+1)%2;    
+    r->send_ack = packet.seqnum;
+    r->recv_seq = (r->recv_seq+1)%2;    
   }
   
   //Send data from A to Layer 5
-  strncpy(data_fromA, packet.payload, 20);
+  memcpy(data_fromA, packet.payload, 20);
   tolayer5(1, data_fromA);
   //cout<<"B_input data sent to layer 5\n";
   
   //Send ACK to A for packet received
-  p_toLayer3.seqnum = recv_seq;
-  p_toLayer3.acknum = send_ack;
+  p_toLayer3.seqnum = r->recv_seq;
+  p_toLayer3.acknum = r->send_ack;
   memset(p_toLayer3.payload,'\0', 20);
   p_toLayer3.checksum = generate_checksum(p_toLayer3);
-  sent_ackPkt = p_toLayer3;
+  r->sent_ackPkt = p_toLayer3;
   
   tolayer3(1, p_toLayer3);
-  //cout<<"B_input ACK"<<send_ack<<" sent to layer 3\n";  
+  //cout<<"B_input ACK"<<r->send_ack<<" sent to layer 3\n";  
+}
+
+/* called by the sampler (-S) for the state of B */
+void B_probe(struct probe *p)
+{
+  p->recv_base = (receivers[get_flow()].send_ack+1)%2;
 }
 
 /* the following rouytine will be called once (only) before any other */
@@ -193,4 +265,9 @@ void B_input(struct pkt packet)
 void B_init()
 {
     //cout<<"Inside B_init\n";
+    //Create receivers for all flows when called for the first one
+    if (get_flow() == 0){
+      delete[] receivers;
+      receivers = new receiver[get_num_flows()];
+    }
 }
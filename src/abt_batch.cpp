@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "../include/rdtsim.h"
+
+/*****************************************************************
+ abt_batch: -k replications of abt, with seeds Seed, Seed+1, ...,
+ run side by side in lockstep (rdtsim_run_abt_batch()).  It reports
+ the means over the replications with their 95% confidence intervals,
+ as abt -r does, and with -v every replication as well.  With -V
+ every replication is also run on its own with rdtsim_run(), and the
+ two must give the same results.
+******************************************************************/
+
+/* in simulator.cpp: half-width of the 95% confidence interval of n values */
+double half_width(double sum, double sumsq, int n);
+
+void display_usage(const char *filename)
+{
+   printf("Usage:\n %s -s Seed -m Number of messages to simulate -l Loss -c Corruption -t Average time between messages from sender's layer5 -k Replications [-R Timeout] [-v Tracing] [-V]\n", filename);
+}
+
+int main(int argc, char **argv)
+{
+   struct rdtsim_config c;
+   struct rdtsim_stats *stats, one;
+   struct timespec started, stopped;
+   double sum[3] = {0, 0, 0}, sumsq[3] = {0, 0, 0}, v[3], wall;
+   int trace = 0, check = 0, nreps = 0, given = 0, opt, i, k, differ = 0;
+
+   memset(&c, 0, sizeof c);
+   c.protocol = "abt";
+   c.window = 1;
+   while ((opt = getopt(argc, argv, "s:m:l:c:t:k:R:v:V")) != -1) {
+      switch (opt) {
+         case 's':   c.seed = atoi(optarg);
+                     break;
+         case 'm':   c.nmsgs = atoi(optarg);
+                     break;
+         case 'l':   c.loss = atof(optarg);
+                     break;
+         case 'c':   c.corrupt = atof(optarg);
+                     break;
+         case 't':   c.lambda = atof(optarg);
+                     break;
+         case 'k':   if ((nreps = atoi(optarg)) < 2) {
+                        fprintf(stderr, "Invalid value for -%c\n", opt);
+                        return -1;
+                     }
+                     break;
+         case 'R':   if ((c.timeout = atof(optarg)) <= 0) {
+                        fprintf(stderr, "Invalid value for -%c\n", opt);
+                        return -1;
+                     }
+                     break;
+         case 'v':   trace = atoi(optarg);
+                     break;
+         case 'V':   check = 1;
+                     break;
+         default:    display_usage(argv[0]);
+                     return -1;
+      }
+      if (strchr("smlctk", opt) != NULL)
+         given |= 1 << (strchr("smlctk", opt) - "smlctk");
+   }
+   if (given != (1 << 6) - 1 || optind != argc) {
+      fprintf(stderr, "Missing arguments!\n");
+      display_usage(argv[0]);
+      return -1;
+   }
+
+   stats = (struct rdtsim_stats *)malloc(nreps * sizeof(struct rdtsim_stats));
+   clock_gettime(CLOCK_MONOTONIC, &started);
+   if (rdtsim_run_abt_batch(&c, nreps, stats) != 0) {
+      fprintf(stderr, "Invalid arguments!\n");
+      return -1;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &stopped);
+   wall = (stopped.tv_sec - started.tv_sec) + (stopped.tv_nsec - started.tv_nsec) / 1e9;
+
+   for (i = 0; i < nreps; i++) {
+      v[0] = stats[i].throughput;
+      v[1] = stats[i].avg_latency;
+      v[2] = stats[i].latency_p99;
+      for (k = 0; k < 3; k++) {
+         sum[k] += v[k];
+         sumsq[k] += v[k] * v[k];
+      }
+      if (trace > 0)
+         printf("[PA2]Seed %d: throughput %f packets/time units, average latency %f, p99 %f time units[/PA2]\n",
+                c.seed + i, v[0], v[1], v[2]);
+      if (check) {
+         c.seed += i;
+         rdtsim_run(&c, &one);
+         c.seed -= i;
+         /* both are zeroed before they are filled in, padding and all */
+         if (memcmp(&one, &stats[i], sizeof one) != 0) {
+            printf("Replication %d (seed %d) differs from its run on its own\n", i, c.seed + i);
+            differ++;
+         }
+      }
+   }
+   printf("[PA2]Replications: %d, in %f seconds[/PA2]\n", nreps, wall);
+   printf("[PA2]Throughput: %f +- %f packets/time units (95%% confidence)[/PA2]\n",
+          sum[0]/nreps, half_width(sum[0], sumsq[0], nreps));
+   printf("[PA2]Average latency: %f +- %f time units (95%% confidence)[/PA2]\n",
+          sum[1]/nreps, half_width(sum[1], sumsq[1], nreps));
+   printf("[PA2]Latency p99: %f +- %f time units (95%% confidence)[/PA2]\n",
+          sum[2]/nreps, half_width(sum[2], sumsq[2], nreps));
+   if (check)
+      printf("[PA2]Checked against runs on their own: %d of %d differ[/PA2]\n", differ, nreps);
+   free(stats);
+   return differ > 0;
+}
@@ -0,0 +1,628 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "../include/histogram.h"
+#include "../include/rdtsim.h"
+
+/*****************************************************************
+ Replications of abt side by side: every lane of a batch runs its
+ own replication of the simulator's default medium with the uniform
+ workload and abt.cpp on top, and the lanes step in lockstep, each
+ simulating its earliest event at every step.  The state of the
+ lanes is kept structure-of-arrays where the lanes are worked on
+ together:
+  - random numbers: every lane has its own copy of each stream the
+    simulator draws from, one per node and one for the msgs of the
+    flow (glibc's additive feedback generator, 31 words), and the
+    lanes short of numbers of a stream draw 31 more together.  A
+    block of 31 brings the generator back to the same word, so all
+    lanes stay at the same place in their state and the loop over
+    the lanes needs no gathers.
+  - the next event of each kind (a msg from layer 5, the timer, and
+    the packets at the head of each direction of the medium): the
+    earliest of them is found for all lanes in one loop.
+ Simulating the event itself is done lane by lane, since the lanes
+ take different branches.  Each replication draws the same numbers
+ in the same order as the scalar run, and events at equal times come
+ out in the same order, so a lane gives exactly what abt -s Seed
+ gives.  abt.cpp and this file must be kept in step.
+******************************************************************/
+
+#define LANES     64
+#define RAND_DEG  31       /* words of the generator */
+#define RAND_SEP  3        /* the generator adds word i-RAND_SEP to word i-RAND_DEG */
+#define MAXDRAWS  5        /* random numbers one event can use from a stream */
+
+/* streams of a lane */
+#define ST_A      0        /* node 0, where A sits */
+#define ST_B      1        /* node 1, where B sits */
+#define ST_MSGS   2        /* msgs of the flow */
+#define NSTREAMS  3
+
+/* as in abt.cpp */
+#define RTT        10
+#define BASE_RTT   12
+#define QUEUE_SIZE 1000
+
+/* kinds of event of a lane */
+#define EV_LAYER5  0       /* msg from layer 5 of A */
+#define EV_TIMER   1       /* A's timer */
+#define EV_TO_B    2       /* packet at the head of the medium, A to B */
+#define EV_TO_A    3       /* and B to A */
+#define NKINDS     4
+
+/* node that schedules the events of each kind */
+static const int origin[NKINDS] = { 0, 0, 0, 1 };
+
+/* a packet crossing the medium */
+struct flight {
+   float at;               /* time it arrives */
+   unsigned int seq;       /* order its event was scheduled in at the node sending it */
+   int   num;              /* seqnum of data, acknum of ACKs, -1 for B's ACK before it has one */
+   int   corrupt;
+};
+
+/* one direction of the medium: packets in arrival order */
+struct medium {
+   struct flight *q;
+   int   head, len, size;
+   float lastarrival;
+};
+
+/* what a lane works on one at a time */
+struct lane {
+   int   rep;              /* replication running, -1 for none */
+   unsigned int evseq[2];  /* events each node has scheduled so far */
+   int   nsim;
+   float cutoff;           /* time of the last msg, INFINITY until known */
+   float last;             /* time of the latest event simulated */
+   struct medium medium[2]; /* to B and to A */
+
+   /* A: abt.cpp's sender */
+   int   send_seq, recv_ack, queue_len;
+   float start_time, timer_fin;
+
+   /* B: abt.cpp's receiver */
+   int   recv_seq, send_ack, ack;   /* acknum of the last ACK sent, -1 for none */
+
+   /* the simulator's flow */
+   float *msgtime, *msgsent;
+   char  *msgdropped;
+   int   maxmsgs;
+   int   application, next, sent, dropped, queued, maxqueued, delivered, nextdeliver;
+   double queuearea, queuedelay, latency;
+   float queuetime, maxqueuedelay;
+   int   A_application, A_transport, B_transport, B_application;
+   struct histogram delays;
+};
+
+struct batch {
+   /* random numbers: the generator of each stream of each lane, */
+   /* and 2 blocks of numbers drawn from it ahead of use          */
+   int32_t  state[NSTREAMS][RAND_DEG][LANES];
+   uint32_t ahead[NSTREAMS][2*RAND_DEG][LANES];
+   int      next[NSTREAMS][LANES];   /* next of ahead[] to use */
+   int      navail[NSTREAMS][LANES]; /* numbers left in ahead[] */
+
+   /* the time of each lane's next event of each kind, INFINITY */
+   /* for none, and the order it was scheduled in               */
+   float    when[NKINDS][LANES];
+   unsigned int seq[NKINDS][LANES];
+   int      kind[LANES];   /* kind of each lane's earliest event */
+
+   struct lane lanes[LANES];
+
+   const struct rdtsim_config *c;
+   float    base_timer;
+   int      nreps, nextrep;
+   struct rdtsim_stats *stats;
+};
+
+/***************************** RANDOM ****************************/
+/* the next block of stream st of lane l, into out[] unless NULL */
+static void block(struct batch *b, int st, int l, uint32_t *out)
+{
+   uint32_t v;
+   int j;
+
+   for (j = 0; j < RAND_DEG; j++) {
+      v = (uint32_t)b->state[st][(j + RAND_SEP) % RAND_DEG][l] + (uint32_t)b->state[st][j][l];
+      b->state[st][(j + RAND_SEP) % RAND_DEG][l] = (int32_t)v;
+      if (out != NULL)
+         out[j] = v >> 1;
+   }
+}
+
+/* seed stream st of lane l as init_stream() would */
+static void seed_stream(struct batch *b, int st, int l, unsigned int seed)
+{
+   uint32_t out[RAND_DEG];
+   int32_t word;
+   long hi, lo;
+   int i;
+
+   if (seed == 0)
+      seed = 1;
+   b->state[st][0][l] = word = (int32_t)seed;
+   for (i = 1; i < RAND_DEG; i++) {
+      hi = word / 127773;
+      lo = word % 127773;
+      word = 16807 * lo - 2836 * hi;
+      if (word < 0)
+         word += 2147483647;
+      b->state[st][i][l] = word;
+   }
+   for (i = 0; i < 10; i++)
+      block(b, st, l, NULL);
+   block(b, st, l, out);
+   for (i = 0; i < RAND_DEG; i++)
+      b->ahead[st][i][l] = out[i];
+   b->next[st][l] = 0;
+   b->navail[st][l] = RAND_DEG;
+}
+
+/* once a lane may run short of stream st in an event, every lane  */
+/* with room for a block draws one, into the half of ahead[] it is */
+/* not reading, so that the lanes mostly draw together             */
+static void refill(struct batch *b, int st)
+{
+   uint32_t need[LANES], low[LANES], high[LANES];   /* masks of the lanes drawing */
+   uint32_t v, *f, *r, *to_low, *to_high;
+   int *next = b->next[st], *navail = b->navail[st];
+   int l, j, any = 0;
+
+   for (l = 0; l < LANES; l++)
+      any |= b->lanes[l].rep >= 0 && navail[l] < MAXDRAWS;
+   if (!any)
+      return;
+   for (l = 0; l < LANES; l++) {
+      need[l] = -(uint32_t)(b->lanes[l].rep >= 0 && navail[l] <= RAND_DEG);
+      high[l] = need[l] & -(uint32_t)((next[l] + navail[l]) % (2*RAND_DEG) / RAND_DEG);
+      low[l] = need[l] & ~high[l];
+   }
+   for (j = 0; j < RAND_DEG; j++) {
+      f = (uint32_t *)b->state[st][(j + RAND_SEP) % RAND_DEG];
+      r = (uint32_t *)b->state[st][j];
+      to_low = b->ahead[st][j];
+      to_high = b->ahead[st][RAND_DEG + j];
+      for (l = 0; l < LANES; l++) {
+         v = f[l] + r[l];
+         f[l] = (v & need[l]) | (f[l] & ~need[l]);
+         to_low[l] = (v >> 1 & low[l]) | (to_low[l] & ~low[l]);
+         to_high[l] = (v >> 1 & high[l]) | (to_high[l] & ~high[l]);
+      }
+   }
+   for (l = 0; l < LANES; l++)
+      navail[l] += RAND_DEG & need[l];
+}
+
+/* jimsrand() for lane l, from stream st */
+static float draw(struct batch *b, int st, int l)
+{
+   int32_t r = (int32_t)b->ahead[st][b->next[st][l]][l];
+
+   b->next[st][l] = (b->next[st][l] + 1) % (2*RAND_DEG);
+   b->navail[st][l]--;
+   return r / 2147483647.0;
+}
+
+/***************************** EVENTS ****************************/
+/* the kind of each lane's earliest event; of events at the same */
+/* time, those node 0 scheduled and then the one scheduled last,  */
+/* as on the simulator's event list                               */
+static void pick(struct batch *b)
+{
+   float t;
+   unsigned int s;
+   int l, i, k, before;
+
+   for (l = 0; l < LANES; l++) {
+      t = b->when[0][l];
+      s = b->seq[0][l];
+      k = 0;
+      for (i = 1; i < NKINDS; i++) {
+         before = (b->when[i][l] < t) | ((b->when[i][l] == t)
+                  & ((origin[i] < origin[k]) | ((origin[i] == origin[k]) & (b->seq[i][l] > s))));
+         t = before ? b->when[i][l] : t;
+         s = before ? b->seq[i][l] : s;
+         k = before ? i : k;
+      }
+      b->kind[l] = k;
+   }
+}
+
+static void schedule(struct batch *b, int l, int kind, float t)
+{
+   b->when[kind][l] = t;
+   b->seq[kind][l] = b->lanes[l].evseq[origin[kind]]++;
+}
+
+static void cancel(struct batch *b, int l, int kind)
+{
+   b->when[kind][l] = INFINITY;
+   b->seq[kind][l] = 0;
+}
+
+/* the head of direction d of lane l's medium is its next event of that kind */
+static void show_head(struct batch *b, int l, int d)
+{
+   struct medium *m = &b->lanes[l].medium[d];
+
+   if (m->len == 0) {
+      cancel(b, l, EV_TO_B + d);
+      return;
+   }
+   b->when[EV_TO_B + d][l] = m->q[m->head].at;
+   b->seq[EV_TO_B + d][l] = m->q[m->head].seq;
+}
+
+static void push(struct medium *m, struct flight *p)
+{
+   int i;
+
+   if (m->len == m->size) {
+      m->size = m->size ? 2*m->size : 16;
+      m->q = (struct flight *)realloc(m->q, m->size * sizeof(struct flight));
+      for (i = 0; i < m->head; i++)
+         m->q[m->len + i] = m->q[i];
+   }
+   m->q[(m->head + m->len++) % m->size] = *p;
+}
+
+static struct flight pop(struct medium *m)
+{
+   struct flight p = m->q[m->head];
+
+   m->head = (m->head + 1) % m->size;
+   m->len--;
+   return p;
+}
+
+/************************** THE SIMULATOR *************************/
+static void update_queue(struct lane *ln, float now, int change)
+{
+   ln->queuearea += (double)ln->queued * (now - ln->queuetime);
+   ln->queuetime = now;
+   ln->queued += change;
+}
+
+/* forward() over the default medium, towards B (d 0) or A (d 1), */
+/* from the node that is not there                                */
+static void forward(struct batch *b, int l, float now, int d, int num)
+{
+   struct lane *ln = &b->lanes[l];
+   struct medium *m = &ln->medium[d];
+   struct flight p;
+   float lastime = now;
+
+   if (draw(b, d, l) < b->c->loss)
+      return;
+   if (m->lastarrival > lastime)
+      lastime = m->lastarrival;
+   p.at = lastime + 1.0f + 9.0f*draw(b, d, l);
+   if (p.at < m->lastarrival)
+      p.at = m->lastarrival;
+   m->lastarrival = p.at;
+   p.num = num;
+   p.corrupt = 0;
+   if (draw(b, d, l) < b->c->corrupt) {
+      draw(b, d, l);       /* which field: every one fails the checksum */
+      p.corrupt = 1;
+   }
+   p.seq = ln->evseq[d]++;
+   push(m, &p);
+   if (m->len == 1)
+      show_head(b, l, d);
+}
+
+static void tolayer3(struct batch *b, int l, float now, int AorB, int num)
+{
+   if (AorB == 0)
+      b->lanes[l].A_transport++;
+   forward(b, l, now, AorB == 0 ? 0 : 1, num);
+}
+
+static void msg_sent(struct lane *ln, float now)
+{
+   float delay;
+
+   while (ln->next < ln->application && ln->msgdropped[ln->next])
+      ln->next++;
+   delay = now - ln->msgtime[ln->next];
+   ln->queuedelay += delay;
+   if (delay > ln->maxqueuedelay)
+      ln->maxqueuedelay = delay;
+   ln->msgsent[ln->next] = now;
+   ln->next++;
+   ln->sent++;
+   update_queue(ln, now, -1);
+}
+
+/* tolayer5() at B, recording the latency of the msg delivered */
+static void tolayer5(struct lane *ln, float now)
+{
+   float total;
+   int n;
+
+   ln->B_application++;
+   while (ln->nextdeliver < ln->application && ln->msgdropped[ln->nextdeliver])
+      ln->nextdeliver++;
+   if (ln->nextdeliver < ln->application) {
+      n = ln->nextdeliver++;
+      total = now - ln->msgtime[n];
+      ln->latency += total;
+      hist_record(&ln->delays, total);
+   }
+   ln->delivered++;
+}
+
+static void generate_next_arrival(struct batch *b, int l, float now)
+{
+   double x = b->c->lambda*draw(b, ST_MSGS, l)*2;
+
+   schedule(b, l, EV_LAYER5, now + x);
+}
+
+/**************************** abt.cpp ****************************/
+static void send_message(struct batch *b, int l, float now)
+{
+   struct lane *ln = &b->lanes[l];
+
+   ln->send_seq = (ln->send_seq+1)%2;
+   ln->start_time = now;
+   if (b->when[EV_TIMER][l] == INFINITY)
+      schedule(b, l, EV_TIMER, now + ln->timer_fin);
+   tolayer3(b, l, now, 0, ln->send_seq);
+   msg_sent(ln, now);
+}
+
+static void A_output(struct batch *b, int l, float now)
+{
+   struct lane *ln = &b->lanes[l];
+
+   if (ln->send_seq != ln->recv_ack) {
+      if (ln->queue_len == QUEUE_SIZE) {
+         ln->msgdropped[ln->application-1] = 1;
+         ln->dropped++;
+         update_queue(ln, now, -1);
+         return;
+      }
+      ln->queue_len++;
+      return;
+   }
+   send_message(b, l, now);
+}
+
+static void A_input(struct batch *b, int l, float now, struct flight *p)
+{
+   struct lane *ln = &b->lanes[l];
+   float new_rtt, new_timer;
+
+   if (p->corrupt || p->num < 0 || p->num == ln->recv_ack)
+      return;
+   if (p->num == ln->send_seq && p->num != ln->recv_ack) {
+      ln->recv_ack = ln->send_seq;
+      cancel(b, l, EV_TIMER);
+      new_rtt = now - ln->start_time;
+      if (new_rtt > RTT) {
+         new_timer = (0.875 * ln->timer_fin) + (0.125 * new_rtt);
+         if (new_timer > RTT && new_timer < 2*b->base_timer)
+            ln->timer_fin = new_timer;
+      }
+      if (ln->queue_len > 0) {
+         ln->queue_len--;
+         send_message(b, l, now);
+      }
+   }
+}
+
+static void A_timerinterrupt(struct batch *b, int l, float now)
+{
+   struct lane *ln = &b->lanes[l];
+
+   ln->timer_fin = b->base_timer;
+   schedule(b, l, EV_TIMER, now + ln->timer_fin);
+   tolayer3(b, l, now, 0, ln->send_seq);
+}
+
+static void B_input(struct batch *b, int l, float now, struct flight *p)
+{
+   struct lane *ln = &b->lanes[l];
+
+   if (p->corrupt || p->num == ln->send_ack) {
+      tolayer3(b, l, now, 1, ln->ack);
+      return;
+   }
+   ln->send_ack = p->num;
+   ln->recv_seq = (ln->recv_seq+1)%2;
+   tolayer5(ln, now);
+   ln->ack = ln->send_ack;
+   tolayer3(b, l, now, 1, ln->ack);
+}
+
+/***************************** LANES *****************************/
+/* start replication rep in lane l, as init(), A_init() and B_init() */
+static void start(struct batch *b, int l, int rep)
+{
+   struct lane *ln = &b->lanes[l];
+   int d, i;
+
+   ln->rep = rep;
+   ln->evseq[0] = ln->evseq[1] = 0;
+   ln->nsim = 0;
+   ln->cutoff = INFINITY;
+   ln->last = 0;
+   for (d = 0; d < 2; d++) {
+      ln->medium[d].head = ln->medium[d].len = 0;
+      ln->medium[d].lastarrival = 0;
+   }
+   for (i = 0; i < NKINDS; i++)
+      cancel(b, l, i);
+   ln->send_seq = ln->recv_ack = -1;
+   ln->queue_len = 0;
+   ln->start_time = 0;
+   ln->timer_fin = b->base_timer;
+   ln->recv_seq = ln->send_ack = ln->ack = -1;
+   ln->application = ln->next = ln->sent = ln->dropped = ln->queued = ln->maxqueued = 0;
+   ln->delivered = ln->nextdeliver = 0;
+   ln->queuearea = ln->queuedelay = ln->latency = 0;
+   ln->queuetime = ln->maxqueuedelay = 0;
+   ln->A_application = ln->A_transport = ln->B_transport = ln->B_application = 0;
+   if (ln->delays.counts != NULL)
+      memset(ln->delays.counts, 0, ln->delays.nbuckets * sizeof(long long));
+   ln->delays.total = 0;
+   ln->delays.max = 0;
+
+   seed_stream(b, ST_A, l, (b->c->seed + rep) ^ 0x9e3779b9u);
+   seed_stream(b, ST_B, l, (b->c->seed + rep) ^ (0x9e3779b9u * 2));
+   seed_stream(b, ST_MSGS, l, (b->c->seed + rep) ^ 0x85ebca6bu);
+   generate_next_arrival(b, l, 0);
+}
+
+/* summarize() for the replication of lane l, over at time now */
+static void finish(struct batch *b, int l, float now)
+{
+   struct lane *ln = &b->lanes[l];
+   struct rdtsim_stats *s = &b->stats[ln->rep];
+   double tput, sumtput, sumsq;
+
+   memset(s, 0, sizeof *s);
+   update_queue(ln, now, 0);
+   s->dropped = ln->dropped;
+   s->max_queue = ln->maxqueued;
+   s->max_queue_delay = ln->maxqueuedelay;
+   tput = now > 0 ? ln->delivered/now : 0.0;
+   sumtput = tput;
+   sumsq = tput*tput;
+   s->A_application = ln->A_application;
+   s->A_transport = ln->A_transport;
+   s->B_transport = ln->B_transport;
+   s->B_application = ln->B_application;
+   s->time = now;
+   s->throughput = ln->B_application/now;
+   s->avg_queue = now > 0 ? ln->queuearea/now : 0.0;
+   s->avg_queue_delay = ln->sent > 0 ? ln->queuedelay/ln->sent : 0.0;
+   s->avg_latency = ln->delivered > 0 ? ln->latency/ln->delivered : 0.0;
+   s->overhead = ln->delivered > 0 ? (double)ln->A_transport/ln->delivered : 0.0;
+   s->latency_p50 = hist_percentile(&ln->delays, 50);
+   s->latency_p99 = hist_percentile(&ln->delays, 99);
+   s->latency_max = ln->delays.max;
+   s->fairness = sumsq > 0 ? sumtput*sumtput/sumsq : 1.0;
+}
+
+/* simulate lane l's earliest event, as handle_event() */
+static void step(struct batch *b, int l)
+{
+   struct lane *ln = &b->lanes[l];
+   struct flight p;
+   int kind = b->kind[l];
+   float now = b->when[kind][l];
+
+   if (now > ln->cutoff && now != INFINITY && kind == EV_LAYER5) {
+      cancel(b, l, EV_LAYER5);          /* msgs after the last are not simulated */
+      return;
+   }
+   if (now > ln->cutoff) {              /* all done with this replication */
+      finish(b, l, now == INFINITY ? ln->last : now);
+      if (b->nextrep < b->nreps)
+         start(b, l, b->nextrep++);
+      else
+         ln->rep = -1;
+      return;
+   }
+   ln->last = now;
+   switch (kind) {
+   case EV_LAYER5:
+      generate_next_arrival(b, l, now);
+      if (ln->application == ln->maxmsgs) {
+         ln->maxmsgs *= 2;
+         ln->msgtime = (float *)realloc(ln->msgtime, ln->maxmsgs * sizeof(float));
+         ln->msgsent = (float *)realloc(ln->msgsent, ln->maxmsgs * sizeof(float));
+         ln->msgdropped = (char *)realloc(ln->msgdropped, ln->maxmsgs * sizeof(char));
+      }
+      ln->msgtime[ln->application] = now;
+      ln->msgsent[ln->application] = now;
+      ln->msgdropped[ln->application] = 0;
+      ln->nsim++;
+      ln->application++;
+      ln->A_application++;
+      update_queue(ln, now, 1);
+      A_output(b, l, now);
+      if (ln->queued > ln->maxqueued)
+         ln->maxqueued = ln->queued;
+      if (ln->nsim == b->c->nmsgs)
+         ln->cutoff = now;
+      break;
+   case EV_TIMER:
+      cancel(b, l, EV_TIMER);
+      A_timerinterrupt(b, l, now);
+      break;
+   case EV_TO_B:
+      p = pop(&ln->medium[0]);
+      show_head(b, l, 0);
+      ln->B_transport++;
+      B_input(b, l, now, &p);
+      break;
+   case EV_TO_A:
+      p = pop(&ln->medium[1]);
+      show_head(b, l, 1);
+      A_input(b, l, now, &p);
+      break;
+   }
+}
+
+int rdtsim_run_abt_batch(const struct rdtsim_config *c, int n, struct rdtsim_stats *stats)
+{
+   struct batch *b;
+   struct lane *ln;
+   int l, d, running;
+
+   if (c->window < 1 || c->nmsgs < 1 || !(c->lambda > 0) || c->nflows > 1 || !(c->timeout >= 0)
+       || !(c->loss >= 0 && c->loss <= 1) || !(c->corrupt >= 0 && c->corrupt <= 1)
+       || c->protocol == NULL || strcmp(c->protocol, "abt") != 0 || n < 0)
+      return -1;
+   b = (struct batch *)calloc(1, sizeof(struct batch));
+   b->c = c;
+   b->base_timer = c->timeout > 0 ? c->timeout : BASE_RTT;
+   b->nreps = n;
+   b->stats = stats;
+   for (l = 0; l < LANES; l++) {
+      ln = &b->lanes[l];
+      ln->rep = -1;
+      for (d = 0; d < NKINDS; d++)
+         cancel(b, l, d);
+      if (b->nextrep < n) {
+         ln->maxmsgs = c->nmsgs;
+         ln->msgtime = (float *)malloc(c->nmsgs * sizeof(float));
+         ln->msgsent = (float *)malloc(c->nmsgs * sizeof(float));
+         ln->msgdropped = (char *)malloc(c->nmsgs * sizeof(char));
+         start(b, l, b->nextrep++);
+      }
+   }
+
+   do {
+      for (d = 0; d < NSTREAMS; d++)
+         refill(b, d);
+      pick(b);
+      running = 0;
+      for (l = 0; l < LANES; l++)
+         if (b->lanes[l].rep >= 0) {
+            step(b, l);
+            running++;
+         }
+   } while (running > 0);
+
+   for (l = 0; l < LANES; l++) {
+      ln = &b->lanes[l];
+      free(ln->msgtime);
+      free(ln->msgsent);
+      free(ln->msgdropped);
+      free(ln->medium[0].q);
+      free(ln->medium[1].q);
+      free(ln->delays.counts);
+   }
+   free(b);
+   return 0;
+}
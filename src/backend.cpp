@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <sys/resource.h>
+#include <set>
+#include <utility>
+
+#include "../include/backend.h"
+#include "../include/common.h"
+#include "../include/workload.h"
+#include "../include/timerwheel.h"
+
+/*****************************************************************
+ Code shared by the real-time backends.  Time units are mapped to
+ wall-clock time with -u (microseconds per time unit), so the protocol
+ timeouts keep their meaning.  Loss and corruption are applied as a
+ packet is handed to the backend, as netem would; the delay is
+ whatever the backend takes.
+******************************************************************/
+
+#define   ARRIVAL 2        /* deadline kinds: timer of A, timer of B, msg from layer 5 */
+#define   RUN_UNITS_PER_MSG 100 /* time units a msg may take beyond its arrival, without -D */
+
+/* Statistics */
+thread_local int A_application = 0;
+thread_local int A_transport = 0;
+thread_local int B_application = 0;
+thread_local int B_transport = 0;
+
+int win_size;
+
+int TRACE = 1;             /* for my debugging */
+int nsim = 0;              /* number of messages from 5 to 4 so far */
+int nsimmax = 0;           /* number of msgs to generate, then stop */
+int ndropped = 0;          /* number of msgs discarded by A */
+float lossprob;            /* probability that a packet is dropped  */
+float corruptprob;         /* probability that one bit is packet is flipped */
+float lambda;              /* arrival rate of messages from layer 5 */
+struct workload *workload; /* generator of messages from layer 5 */
+double usec_per_unit = 10; /* wall-clock length of a time unit */
+float pace_rate = 0;       /* -P: packets per time unit, PACE_RTT, or 0 for no pacing */
+int   pace_burst = 1;      /* packets that may be sent back to back */
+int   congestion = CC_NONE; /* -C: how the senders adapt their windows */
+int   nacks = 0;           /* -N: receivers NACK gaps */
+float basetimeout = 0;     /* -R: senders' timeout, 0 for the protocol's own */
+double run_limit = 0;      /* -D: time units the run may take, 0 to go by the msgs */
+int   msgsize = 20;        /* -M: bytes used in each msg from layer 5 */
+thread_local int ntolayer3; /* number sent into layer 3 */
+thread_local int nlost;     /* number lost in media */
+thread_local int ncorrupt;  /* number corrupted by media*/
+thread_local int nfull;     /* number the backend had no room for */
+
+struct flow *flows;
+int   nflows = 1;          /* number of flows */
+thread_local int cur_flow = 0; /* flow of the event being processed */
+
+/* pending deadlines of this thread, as (time, flow*3 + kind) */
+thread_local std::set<std::pair<double, int> > deadlines;
+thread_local struct wheel timers; /* logical timers of this thread */
+
+struct timespec start;     /* wall-clock time of time 0 */
+int seed;
+thread_local unsigned short randstate[3];
+
+/* A and B may run in separate threads or processes, so each draws */
+/* from its own stream                                             */
+float jimsrand()
+{
+  return erand48(randstate);
+}
+
+void seed_random(int AorB)
+{
+  randstate[0] = 0x330e;
+  randstate[1] = seed;
+  randstate[2] = (seed >> 16) ^ (AorB * 0x5deb);
+}
+
+double now()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((ts.tv_sec - start.tv_sec) * 1e6 + (ts.tv_nsec - start.tv_nsec) / 1e3) / usec_per_unit;
+}
+
+void set_deadline(int f, int kind, double t)
+{
+   if (flows[f].deadline[kind] >= 0)
+      deadlines.erase(std::make_pair(flows[f].deadline[kind], f*3 + kind));
+   flows[f].deadline[kind] = t;
+   if (t >= 0)
+      deadlines.insert(std::make_pair(t, f*3 + kind));
+}
+
+double next_deadline()
+{
+   double t = deadlines.empty() ? -1 : deadlines.begin()->first;
+   float w = wheel_next(&timers);
+
+   if (w != INFINITY && (t < 0 || w < t))
+      t = w;
+   return t;
+}
+
+void schedule_arrival(int f, double after)
+{
+   double x;
+
+   if (nsim >= nsimmax)
+      return;
+   if ((x = workload->next_arrival(f, after, &flows[f].msglen)) >= 0)
+      set_deadline(f, ARRIVAL, after + x);
+}
+
+/* pass a msg from layer 5 to A of flow f */
+void layer5_arrival(int f, double t)
+{
+   struct flow *fp = &flows[f];
+   struct msg msg2give;
+   int i;
+
+   set_deadline(f, ARRIVAL, -1);
+   if (nsim == nsimmax)
+      return;
+   for (i=0; i<20; i++)
+      msg2give.data[i] = i < fp->msglen ? 97 + fp->application % 26 : 0;
+   nsim++;
+   fp->application++;
+   fp->queued++;
+   A_application++;
+   cur_flow = f;
+   A_output(msg2give);
+   if (!workload->backlogged)
+      schedule_arrival(f, t);
+   else if (fp->queued == 0 && fp->deadline[ARRIVAL] < 0)
+      schedule_arrival(f, now());
+}
+
+void run_deadlines()
+{
+   double t = now();
+   int f, kind, id;
+
+   while (!deadlines.empty() && deadlines.begin()->first <= t) {
+      f = deadlines.begin()->second / 3;
+      kind = deadlines.begin()->second % 3;
+      if (kind == ARRIVAL) {
+         layer5_arrival(f, deadlines.begin()->first);
+         continue;
+      }
+      set_deadline(f, kind, -1);
+      cur_flow = f;
+      if (TRACE>=2)
+         printf("\nEVENT time: %f,  type: 0, timerinterrupt   entity: %d\n", t, kind);
+      if (kind == A)
+         A_timerinterrupt();
+   }
+   while ((id = wheel_expire(&timers, t, &f, &kind)) >= 0) {
+      cur_flow = f;
+      if (TRACE>=2)
+         printf("\nEVENT time: %f,  type: 4, timerinterrupt %d   entity: %d\n", t, id, kind);
+      if (kind == A)
+         A_timerinterrupt_id(id);
+   }
+}
+
+int finished()
+{
+   return nsim >= nsimmax && B_application + ndropped >= nsimmax;
+}
+
+int out_of_time()
+{
+   if (now() <= run_limit)
+      return 0;
+   fprintf(stderr, "No end after %f time units, giving up\n", run_limit);
+   return 1;
+}
+
+static void usage(char *filename)
+{
+	display_usage(filename, "[-u Microseconds per time unit] [-P Rate|rtt[:Burst]] [-C aimd] [-N] [-R Timeout] [-M Msg size] [-D Time limit]");
+}
+
+#define REQUIRED_OPTS "swmlctv"
+
+void setup(int argc, char **argv)
+{
+   int opt;
+   int given = 0;              /* bit set for each required option seen */
+   const char *wlspec = "uniform";
+   const char *wlarg;
+
+   while((opt = getopt(argc, argv,"s:w:m:l:c:t:v:a:n:u:P:C:NR:M:D:")) != -1){
+    	switch (opt){
+    		case 's':   seed = read_arg_int(opt);
+                    	break;
+            case 'w':   win_size = read_arg_int(opt);
+            			break;
+            case 'm': 	nsimmax = read_arg_int(opt);
+            			break;
+            case 'l': 	lossprob = read_arg_float(opt);
+            			break;
+            case 'c': 	corruptprob = read_arg_float(opt);
+            			break;
+            case 't': 	if((lambda = atof(optarg)) <= 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'v': 	TRACE = read_arg_int(opt);
+            			break;
+            case 'a': 	if((workload = find_workload(optarg)) == NULL){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			wlspec = optarg;
+            			break;
+            case 'n': 	if((nflows = read_arg_int(opt)) < 1){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'u': 	if((usec_per_unit = atof(optarg)) <= 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'P': 	if(parse_pacing(optarg, &pace_rate, &pace_burst) != 0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'C': 	if(strcmp(optarg, "aimd") != 0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			congestion = CC_AIMD;
+            			break;
+            case 'N': 	nacks = 1;
+            			break;
+            case 'R': 	if((basetimeout = atof(optarg)) <= 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'M': 	if((msgsize = read_arg_int(opt)) < 1 || msgsize > 20){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			set_msg_size(msgsize);
+            			break;
+            case 'D': 	if((run_limit = atof(optarg)) <= 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case '?':
+           	default:    fprintf(stderr, "Invalid arguments!\n");
+						usage(argv[0]);
+						exit(-1);
+       }
+       if (strchr(REQUIRED_OPTS, opt) != NULL)
+          given |= 1 << (strchr(REQUIRED_OPTS, opt) - REQUIRED_OPTS);
+    }
+
+   //Check that all required arguments were given
+   if(given != (1 << strlen(REQUIRED_OPTS)) - 1 || optind != argc){
+   		fprintf(stderr, "Missing arguments!\n");
+		usage(argv[0]);
+		exit(-1);
+   }
+
+   if (workload == NULL)
+      workload = find_workload(wlspec);
+   wlarg = strchr(wlspec, ':');
+   if (workload->init(wlarg ? wlarg+1 : NULL, lambda, nflows) != 0)
+      exit(-1);
+   if (run_limit == 0)
+      run_limit = (nsimmax / nflows + 1) * (lambda + RUN_UNITS_PER_MSG);
+
+   seed_random(A);
+   flows = (struct flow *)calloc(nflows, sizeof(struct flow));
+   for (cur_flow=0; cur_flow<nflows; cur_flow++) {
+      flows[cur_flow].deadline[A] = flows[cur_flow].deadline[B] = flows[cur_flow].deadline[ARRIVAL] = -1;
+      A_init();
+      B_init();
+   }
+   cur_flow = 0;
+}
+
+void start_clock()
+{
+   clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+void start_arrivals()
+{
+   int i;
+
+   for (i=0; i<nflows; i++)
+      schedule_arrival(i, 0);
+}
+
+void report(double elapsed)
+{
+   struct rusage self, children;
+   double cpu;
+
+   getrusage(RUSAGE_SELF, &self);
+   getrusage(RUSAGE_CHILDREN, &children);
+   cpu = self.ru_utime.tv_sec + self.ru_stime.tv_sec + children.ru_utime.tv_sec + children.ru_stime.tv_sec
+       + (self.ru_utime.tv_usec + self.ru_stime.tv_usec + children.ru_utime.tv_usec + children.ru_stime.tv_usec) / 1e6;
+
+   printf(" Simulator terminated at time %f\n after sending %d msgs from layer5\n", elapsed, nsim);
+
+   printf("\n");
+   printf("[PA2]%d packets sent from the Application Layer of Sender A[/PA2]\n", A_application);
+   printf("[PA2]%d packets sent from the Transport Layer of Sender A[/PA2]\n", A_transport);
+   printf("[PA2]%d packets received at the Transport layer of Receiver B[/PA2]\n", B_transport);
+   printf("[PA2]%d packets received at the Application layer of Receiver B[/PA2]\n", B_application);
+   printf("[PA2]Total time: %f time units[/PA2]\n", elapsed);
+   printf("[PA2]Throughput: %f packets/time units[/PA2]\n", B_application/elapsed);
+
+   printf("[PA2]Messages dropped at Sender A: %d[/PA2]\n", ndropped);
+   printf("[PA2]Packets lost: %d, corrupted: %d, dropped by the transport: %d[/PA2]\n", nlost, ncorrupt, nfull);
+   printf("[PA2]Wall-clock time: %f s[/PA2]\n", elapsed * usec_per_unit / 1e6);
+   printf("[PA2]Wall-clock throughput: %f msgs/s[/PA2]\n", B_application / (elapsed * usec_per_unit / 1e6));
+   printf("[PA2]CPU time per packet: %f us[/PA2]\n", ntolayer3 > 0 ? cpu * 1e6 / ntolayer3 : 0.0);
+}
+
+/********************** Student-callable ROUTINES ***********************/
+
+void stoptimer(int AorB)
+{
+ if (TRACE>2)
+    printf("          STOP TIMER: stopping timer at %f\n", now());
+ if (flows[cur_flow].deadline[AorB] < 0) {
+    printf("Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+ }
+ set_deadline(cur_flow, AorB, -1);
+}
+
+void starttimer(int AorB, float increment)
+{
+ double t = now();
+
+ if (TRACE>2)
+    printf("          START TIMER: starting timer at %f\n", t);
+ if (flows[cur_flow].deadline[AorB] >= 0) {
+      printf("Warning: attempt to start a timer that is already started\n");
+      return;
+      }
+ set_deadline(cur_flow, AorB, t + increment);
+}
+
+int starttimer_id(int AorB, float increment)
+{
+ double t = now();
+
+ if (TRACE>2)
+    printf("          START TIMER: starting timer at %f\n", t);
+ return wheel_add(&timers, t + increment, cur_flow, AorB);
+}
+
+void stoptimer_id(int AorB, int id)
+{
+ if (TRACE>2)
+    printf("          STOP TIMER: stopping timer %d at %f\n", id, now());
+ if (!wheel_cancel(&timers, id))
+    printf("Warning: unable to cancel timer %d. It wasn't running.\n", id);
+}
+
+void tolayer3(int AorB, struct pkt packet)
+{
+ struct wire w;
+
+ ntolayer3++;
+ if (AorB == A) A_transport += 1;
+
+ if (lose_packet(lossprob))
+    return;
+ w.flow = cur_flow;
+ w.pkt = packet;
+ corrupt_packet(&w.pkt, corruptprob);
+ send_packet(AorB, &w);
+}
+
+void tolayer5(int AorB, char *datasent)
+{
+  int i;
+
+  if (TRACE>2) {
+     printf("          TOLAYER5: data received: ");
+     for (i=0; i<20; i++)
+        printf("%c",datasent[i]);
+     printf("\n");
+  }
+  if (AorB == B)
+     B_application += 1;
+}
+
+int getwinsize()
+{
+	return win_size;
+}
+
+float get_sim_time()
+{
+	return now();
+}
+
+float get_pace_rate()
+{
+	return pace_rate;
+}
+
+int get_pace_burst()
+{
+	return pace_burst;
+}
+
+int get_congestion_control()
+{
+	return congestion;
+}
+
+int get_nacks()
+{
+	return nacks;
+}
+
+float get_timeout()
+{
+	return basetimeout;
+}
+
+int get_msg_size()
+{
+	return msgsize;
+}
+
+/* the real-time report has no line for the window */
+void window_changed(int AorB, float window)
+{
+}
+
+int get_flow()
+{
+	return cur_flow;
+}
+
+int get_num_flows()
+{
+	return nflows;
+}
+
+void msg_sent(int AorB)
+{
+  struct flow *fp = &flows[cur_flow];
+
+  if (AorB != A || fp->queued == 0)
+     return;
+  fp->queued--;
+  if (workload->backlogged && fp->queued == 0 && fp->deadline[ARRIVAL] < 0)
+     schedule_arrival(cur_flow, now());
+}
+
+void msg_dropped(int AorB)
+{
+  struct flow *fp = &flows[cur_flow];
+
+  if (AorB != A || fp->queued == 0)
+     return;
+  fp->queued--;
+  ndropped++;
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/chrometrace.h"
+
+/* tracks of each flow's process */
+#define TID_A   1
+#define TID_B   2
+#define TID_AB  3                  /* packets from A to B */
+#define TID_BA  4
+#define US      1000.0             /* microseconds in a time unit */
+
+static FILE *out = NULL;
+static int   nevents;              /* written so far, for the commas */
+static long long npackets;         /* ids handed out to packets */
+static long long *timerspans;      /* starts of the timer of starttimer(), per flow and entity */
+
+/* start an event of phase ph; the caller adds any fields and the "}" */
+static void event(const char *ph, const char *cat, const char *name, int pid, int tid, float t)
+{
+   fprintf(out, "%s{\"ph\":\"%s\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+           nevents++ ? ",\n" : "", ph, cat, name, pid, tid, t * US);
+}
+
+static void name_track(int pid, int tid, const char *what, const char *name, int n)
+{
+   fprintf(out, "%s{\"ph\":\"M\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"",
+           nevents++ ? ",\n" : "", what, pid, tid);
+   fprintf(out, name, n);
+   fprintf(out, "\"}}");
+}
+
+int ct_open(const char *path, int nflows)
+{
+   int f;
+
+   if ((out = fopen(path, "w")) == NULL) {
+      perror(path);
+      return -1;
+   }
+   timerspans = (long long *)calloc(2*nflows, sizeof(long long));
+   fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+   for (f = 0; f < nflows; f++) {
+      name_track(f, 0, "process_name", "Flow %d", f);
+      name_track(f, TID_A, "thread_name", "A", 0);
+      name_track(f, TID_B, "thread_name", "B", 0);
+      name_track(f, TID_AB, "thread_name", "A to B", 0);
+      name_track(f, TID_BA, "thread_name", "B to A", 0);
+   }
+   return 0;
+}
+
+void ct_close()
+{
+   if (out == NULL)
+      return;
+   fprintf(out, "\n]}\n");
+   fclose(out);
+   out = NULL;
+}
+
+int ct_enabled()
+{
+   return out != NULL;
+}
+
+/***************************** MSGS ****************************/
+static void msg_event(const char *ph, const char *name, int flow, int n, int tid, float t)
+{
+   event(ph, "msg", name, flow, tid, t);
+   fprintf(out, ",\"id\":\"m%d.%d\"", flow, n);
+}
+
+void ct_msg_begin(int flow, int n, float t)
+{
+   if (out == NULL)
+      return;
+   msg_event("b", "msg", flow, n, TID_A, t);
+   fprintf(out, ",\"args\":{\"msg\":%d}}", n);
+}
+
+void ct_msg_dropped(int flow, int n, float t)
+{
+   if (out == NULL)
+      return;
+   msg_event("e", "msg", flow, n, TID_A, t);
+   fprintf(out, ",\"args\":{\"fate\":\"dropped at A\"}}");
+}
+
+/* a phase of msg n, nested in its span */
+static void msg_phase(const char *name, int flow, int n, int tid, float from, float to)
+{
+   if (to <= from)
+      return;
+   msg_event("b", name, flow, n, tid, from);
+   fprintf(out, "}");
+   msg_event("e", name, flow, n, tid, to);
+   fprintf(out, "}");
+}
+
+void ct_msg_end(int flow, int n, float from, float sent, float copy, float t)
+{
+   if (out == NULL)
+      return;
+   if (copy < sent)
+      copy = sent;
+   msg_phase("queued at A", flow, n, TID_A, from, sent);
+   msg_phase("held up by losses", flow, n, TID_A, sent, copy);
+   msg_phase("crossing", flow, n, TID_AB, copy, t);
+   msg_event("e", "msg", flow, n, TID_B, t);
+   fprintf(out, ",\"args\":{\"fate\":\"delivered\"}}");
+}
+
+/**************************** PACKETS ***************************/
+static void packet_event(const char *ph, const char *name, int flow, int AorB, long long id, float t)
+{
+   event(ph, "packet", name, flow, AorB == 0 ? TID_AB : TID_BA, t);
+   fprintf(out, ",\"id\":\"p%lld\"", id);
+}
+
+long long ct_packet_begin(int flow, int AorB, int seqnum, int acknum, float t)
+{
+   if (out == NULL)
+      return 0;
+   packet_event("b", AorB == 0 ? "data" : "ack", flow, AorB, ++npackets, t);
+   fprintf(out, ",\"args\":{\"seqnum\":%d,\"acknum\":%d}}", seqnum, acknum);
+   return npackets;
+}
+
+void ct_packet_mark(int flow, int AorB, long long id, const char *what, float t)
+{
+   if (out == NULL)
+      return;
+   packet_event("n", what, flow, AorB, id, t);
+   fprintf(out, "}");
+}
+
+void ct_packet_end(int flow, int AorB, long long id, const char *fate, float t)
+{
+   if (out == NULL)
+      return;
+   packet_event("e", AorB == 0 ? "data" : "ack", flow, AorB, id, t);
+   fprintf(out, ",\"args\":{\"fate\":\"%s\"}}", fate);
+}
+
+/***************************** TIMERS ***************************/
+static void timer_event(const char *ph, int flow, int AorB, int id, float t)
+{
+   event(ph, "timer", "timer", flow, AorB == 0 ? TID_A : TID_B, t);
+   if (id < 0)
+      fprintf(out, ",\"id\":\"c%d.%d.%lld\"", flow, AorB, timerspans[2*flow + AorB]);
+   else
+      fprintf(out, ",\"id\":\"t%d\"", id);
+}
+
+void ct_timer_begin(int flow, int AorB, int id, float t, float increment)
+{
+   if (out == NULL)
+      return;
+   if (id < 0)
+      timerspans[2*flow + AorB]++;
+   timer_event("b", flow, AorB, id, t);
+   fprintf(out, ",\"args\":{\"id\":%d,\"timeout\":%f}}", id, increment);
+}
+
+void ct_timer_end(int flow, int AorB, int id, const char *how, float t)
+{
+   if (out == NULL)
+      return;
+   timer_event("e", flow, AorB, id, t);
+   fprintf(out, ",\"args\":{\"fate\":\"%s\"}}", how);
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <string.h>
+
+#include "../include/common.h"
+#include "../include/workload.h"
+
+/**
+ * Checks if the array pointed to by input holds a valid number.
+ *
+ * @param  input char* to the array holding the value.
+ * @return TRUE or FALSE
+ */
+int isNumber(char *input)
+{
+    while (*input){
+        if (!isdigit(*input))
+            return 0;
+        else
+            input += 1;
+    }
+
+    return 1;
+}
+
+int read_arg_int(char c)
+{
+	if(!isNumber(optarg)) {
+		fprintf(stderr, "Invalid value for -%c\n", c);
+		exit(-1);
+	}
+	return atoi(optarg);
+}
+
+float read_arg_float(char c)
+{
+	float val = atof(optarg);
+	if(val < 0.0 || val > 1.0){
+		fprintf(stderr, "Invalid value for -%c\n", c);
+		exit(-1);
+	}
+	return val;
+}
+
+int parse_pacing(const char *spec, float *rate, int *burst)
+{
+   char *end;
+
+   if (strncmp(spec, "rtt", 3) == 0) {
+      *rate = PACE_RTT;
+      end = (char *)spec + 3;
+   }
+   else if ((*rate = strtof(spec, &end)) <= 0 || end == spec)
+      return -1;
+   if (*end == ':' && (*burst = strtol(end+1, &end, 10)) < 1)
+      return -1;
+   return *end == '\0' ? 0 : -1;
+}
+
+void display_usage(char *filename, const char *options)
+{
+	printf("Usage:\n %s -s Seed -w Window size -m Number of messages to simulate -l Loss -c Corruption -t Average time between messages from sender's layer5 -v Tracing [-a Workload[:args]] [-n Flows] %s\n", filename, options);
+	list_workloads();
+}
+
+int lose_packet(float prob)
+{
+ if (jimsrand() >= prob)
+    return 0;
+ nlost++;
+ if (TRACE>0)
+    printf("          TOLAYER3: packet being lost\n");
+ return 1;
+}
+
+int corrupt_packet(struct pkt *p, float prob)
+{
+ float x;
+
+ if (jimsrand() >= prob)
+    return 0;
+ ncorrupt++;
+ if ( (x = jimsrand()) < .75)
+    p->payload[0]='Z';   /* corrupt payload */
+ else if (x < .875)
+    p->seqnum = 999999;
+ else
+    p->acknum = 999999;
+ if (TRACE>0)
+    printf("          TOLAYER3: packet being corrupted\n");
+ return 1;
+}
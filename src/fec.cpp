@@ -0,0 +1,142 @@
+#include "../include/simulator.h"
+#include "../include/fec_engine.h"
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+/* ******************************************************************
+ ALTERNATING BIT AND GO-BACK-N NETWORK EMULATOR: VERSION 1.1  J.F.Kurose
+
+   This code should be used for PA2, unidirectional data transfer 
+   protocols (from A to B). Network properties:
+   - one way network delay averages five time units (longer if there
+     are other messages in the channel for GBN), but can be larger
+   - packets can be corrupted (either the header or the data portion)
+     or lost, according to user-defined probabilities
+   - packets will be delivered in the order in which they were sent
+     (although some can be lost).
+**********************************************************************/
+
+/********* STUDENTS WRITE THE NEXT SEVEN ROUTINES *********/
+//Selective Repeat with an XOR parity packet after every FEC_K data
+//packets, so B can rebuild one lost packet per block by itself.
+//Windows up to half the largest capacity here get an engine specialised
+//for it; larger ones use the engine sized at run time.  Seqnums are one
+//byte up to a window of 32 and two up to 1024, as for SR; FEC_K divides
+//both, so blocks do not straddle the wrap.  Msgs of at most
+//SHORT_PAYLOAD bytes (-M) get engines that carry, and XOR, only those
+#define PAYLOAD 20
+#define SHORT_PAYLOAD 8
+#define FEC_K 4
+
+static rdt_sender **senders = NULL; //Sender of each flow
+static rdt_receiver **receivers = NULL; //Receiver of each flow
+static int nsenders = 0, nreceivers = 0; //Flows they were made for, by the last run
+
+template <int P>
+static rdt_sender *new_sender(int window){
+  if (2*window <= 16) return new fec_sender<16, P, uint8_t, FEC_K>(window);
+  if (2*window <= 64) return new fec_sender<64, P, uint8_t, FEC_K>(window);
+  if (2*window <= 256) return new fec_sender<256, P, uint16_t, FEC_K>(window);
+  if (2*window <= 2048) return new fec_sender<2048, P, uint16_t, FEC_K>(window);
+  return new fec_sender<0, P, unsigned int, FEC_K>(window);
+}
+
+template <int P>
+static rdt_receiver *new_receiver(int window){
+  if (2*window <= 16) return new fec_receiver<16, P, uint8_t, FEC_K>(window);
+  if (2*window <= 64) return new fec_receiver<64, P, uint8_t, FEC_K>(window);
+  if (2*window <= 256) return new fec_receiver<256, P, uint16_t, FEC_K>(window);
+  if (2*window <= 2048) return new fec_receiver<2048, P, uint16_t, FEC_K>(window);
+  return new fec_receiver<0, P, unsigned int, FEC_K>(window);
+}
+
+/* called from layer 5, passed the data to be sent to other side */
+void A_output(struct msg message)
+{
+  senders[get_flow()]->output(message);
+}
+
+/* called from layer 3, when a packet arrives for layer 4 */
+void A_input(struct pkt packet)
+{
+  senders[get_flow()]->input(packet);
+}
+
+/* called when A's timer goes off */
+void A_timerinterrupt()
+{
+  senders[get_flow()]->timerinterrupt();
+}  
+
+/* called when one of A's logical timers goes off */
+void A_timerinterrupt_id(int id)
+{
+  senders[get_flow()]->timerinterrupt_id(id);
+}
+
+/* called by the sampler (-S) for the state of A */
+void A_probe(struct probe *p)
+{
+  senders[get_flow()]->probe(p);
+}
+
+/* the following routine will be called once (only) before any other */
+/* entity A routines are called. You can use it to do any initialization */
+void A_init()
+{
+  //Create senders for all flows when called for the first one,
+  //after freeing those of any earlier run
+  if (get_flow() == 0){
+    for (int i = 0; i < nsenders; i++){
+      delete senders[i];
+    }
+    delete[] senders;
+    senders = new rdt_sender *[nsenders = get_num_flows()];
+  }
+  if (get_msg_size() <= SHORT_PAYLOAD){
+    senders[get_flow()] = new_sender<SHORT_PAYLOAD>(getwinsize());
+  }
+  else{
+    senders[get_flow()] = new_sender<PAYLOAD>(getwinsize());
+  }
+}
+
+/* Note that with simplex transfer from a-to-B, there is no B_output() */
+
+/* called from layer 3, when a packet arrives for layer 4 at B*/
+void B_input(struct pkt packet)
+{
+  receivers[get_flow()]->input(packet);
+}
+
+/* called by the sampler (-S) for the state of B */
+void B_probe(struct probe *p)
+{
+  receivers[get_flow()]->probe(p);
+}
+
+/* the following rouytine will be called once (only) before any other */
+/* entity B routines are called. You can use it to do any initialization */
+void B_init()
+{
+  //Create receivers for all flows when called for the first one,
+  //after freeing those of any earlier run
+  if (get_flow() == 0){
+    for (int i = 0; i < nreceivers; i++){
+      delete receivers[i];
+    }
+    delete[] receivers;
+    receivers = new rdt_receiver *[nreceivers = get_num_flows()];
+  }
+  if (get_msg_size() <= SHORT_PAYLOAD){
+    receivers[get_flow()] = new_receiver<SHORT_PAYLOAD>(getwinsize());
+  }
+  else{
+    receivers[get_flow()] = new_receiver<PAYLOAD>(getwinsize());
+  }
+}
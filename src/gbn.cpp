@@ -1,7 +1,9 @@
 #include "../include/simulator.h"
+#include "../include/gbn_engine.h"
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <vector>
 using namespace std;
 
 /* ******************************************************************
@@ -18,180 +20,84 @@ using namespace std;
 **********************************************************************/
 
 /********* STUDENTS WRITE THE NEXT SEVEN ROUTINES *********/
-//Global Params
-#define RTT 10
-#define BASE_RTT 18
-
-//Sender
-static int send_base = 1; //Seq no of first packet in sender's window
-static int nextseqnum = 1; //Seq num of next packet that will be sent
-static int window = 0; //Window size of sender
-static int buffer_pos = -1; // Position of buffer pointer
-
-//static int recv_ack = 0; //Ack num of last ACK received from B
-static struct pkt sent_dataPkt[1010]; // Buffer of the data packet sent to B
-static float start_time, end_time, timer_fin = 0.0;
-
-//Receiver
-static int expectedseqnum = 1; //Expected Seq no of next packet received from A
-static struct pkt sent_ackPkt; // Copy of last ACK sent to A
-
-//Function to generate checksum
-int generate_checksum(struct pkt p){
-  int checksum = 0;
-  
-  for (int i = 0; i < 20; i++){
-    checksum += p.payload[i];
-  }
-
-  checksum += p.seqnum;
-  checksum += p.acknum;
-  
-  //cout<<"Generated Checksum: "<<~checksum<<endl;
-  return ~checksum;
+//Windows up to the largest capacity here get an engine specialised for
+//it; larger ones use the engine sized at run time.  Links keep packets
+//in order, so seqnums only need to tell apart a window and one more:
+//one byte does up to a window of 128 and two up to 1024.  Msgs of at
+//most SHORT_PAYLOAD bytes (-M) get engines that carry only those
+#define PAYLOAD 20
+#define SHORT_PAYLOAD 8
+
+static rdt_sender **senders = NULL; //Sender of each flow
+static rdt_receiver **receivers = NULL; //Receiver of each flow
+static int nsenders = 0, nreceivers = 0; //Flows they were made for, by the last run
+
+template <int P>
+static rdt_sender *new_sender(int window){
+  if (window <= 8) return new gbn_sender<8, P, uint8_t>(window);
+  if (window <= 32) return new gbn_sender<32, P, uint8_t>(window);
+  if (window <= 128) return new gbn_sender<128, P, uint8_t>(window);
+  if (window <= 1024) return new gbn_sender<1024, P, uint16_t>(window);
+  return new gbn_sender<0, P, unsigned int>(window);
 }
 
-//Function to verify checksum
-bool check_corrupt(struct pkt p){
-  int check = 0;
-  check += p.seqnum;
-  check += p.acknum;
-  check += p.checksum; 
-  
-  for (int i = 0; i < 20; i++){
-    check += p.payload[i];
-  }  
-
-  //cout<<"Checking Checksum: "<<p.checksum; 
-  if (check == -1){
-    //cout<<" NOT Corrupt"<<endl;    
-    return false;
-  }
-  else{
-    //cout<<" CORRUPT:"<<check<<endl;
-    return true;
-  }
+//The receiver keeps seqnums in the same type as the sender
+template <int P>
+static rdt_receiver *new_receiver(int window){
+  if (window <= 128) return new gbn_receiver<P, uint8_t>();
+  if (window <= 1024) return new gbn_receiver<P, uint16_t>();
+  return new gbn_receiver<P, unsigned int>();
 }
 
 /* called from layer 5, passed the data to be sent to other side */
 void A_output(struct msg message)
 {
-  //cout<<"A_output Base:"<<send_base<<" nextseqnum:"<<nextseqnum<<" window:"<<window<<endl;
-
-  //Create new pkt to send to layer 3
-  struct pkt p_toLayer3;
-  
-  p_toLayer3.seqnum = nextseqnum;
-  p_toLayer3.acknum = nextseqnum;
-  strncpy(p_toLayer3.payload, message.data, 20);
-  p_toLayer3.checksum = generate_checksum(p_toLayer3); 
-  
-  //Store a copy of Message
-  sent_dataPkt[nextseqnum++] = p_toLayer3;
-  
-  //Send when packet is within sender window
-  if (p_toLayer3.seqnum < send_base+window){
-    tolayer3(0, p_toLayer3);    
-  
-    if (send_base == nextseqnum-1){
-      start_time = get_sim_time();      
-      //cout<<"A_output sent to layer 3, SEQ:"<<send_base<<" Data:"<<message.data<<" Time:"<<get_sim_time()<<endl;
-      starttimer(0, timer_fin);
-    }
-  }
-  
-  //Buffer if packet seqnum is out of sender window  
-  else{
-    //cout<<"A_output Message SEQ:"<<nextseqnum-1<<" buffered"<<endl;
-    if (buffer_pos == -1){
-      buffer_pos = nextseqnum-1;
-    }    
-  }
+  senders[get_flow()]->output(message);
 }
 
 /* called from layer 3, when a packet arrives for layer 4 */
 void A_input(struct pkt packet)
 {
-  //cout<<"A_input ACK:"<<packet.acknum<<" received at time:"<<get_sim_time()<<endl; 
-  
-  //Check if ACK is corrupt
-  if (!check_corrupt(packet)){
-    if (send_base > packet.acknum){
-      //Restart timer
-      stoptimer(0);
-      starttimer(0, timer_fin);      
-      return;
-    }
-    send_base = packet.acknum + 1;
-    
-    if (send_base == nextseqnum){
-      stoptimer(0);  
-      
-      //Update timer based on new_rtt only if new_rtt is more than base RTT - to ignore quick ACK's for retransmissions
-      end_time = get_sim_time();
-      float new_rtt = end_time - start_time;
-      if (new_rtt > RTT){
-        float new_timer = (0.875 * timer_fin) + (0.125 * new_rtt);
-        if (new_timer > RTT && new_timer < 2*BASE_RTT){
-          timer_fin = new_timer;
-        }
-        //cout<<"Inside A_input. New RTT:"<<new_rtt<<" New timer set to:"<<timer_fin<<endl;
-      }          
-    }
-    
-    else{
-      //Restart timer
-      stoptimer(0);
-      starttimer(0, timer_fin);
-      
-      //Update timer based on new_rtt only if new_rtt is more than base RTT - to ignore quick ACK's for retransmissions
-      end_time = get_sim_time();
-      float new_rtt = end_time - start_time;
-      if (new_rtt > RTT){
-        float new_timer = (0.875 * timer_fin) + (0.125 * new_rtt);
-        if (new_timer > RTT && new_timer < 2*BASE_RTT){
-          timer_fin = new_timer;
-        }
-        //cout<<"Inside A_input. New RTT:"<<new_rtt<<" New timer set to:"<<timer_fin<<endl;
-      }  
-      
-      //Check and send any buffered messages that fall into the new sender window
-      if (buffer_pos != -1){
-        for (int i = buffer_pos; (i < nextseqnum) && (i < send_base+window); i++){
-          tolayer3(0, sent_dataPkt[i]);
-          buffer_pos++;
-        }
-      }
-      if (buffer_pos == nextseqnum){
-        buffer_pos = -1;
-      }      
-    }    
-  }
-  else{
-    //cout<<"Inside A_input. ACK corrupt\n";    
-    return;
-  }
+  senders[get_flow()]->input(packet);
 }
 
 /* called when A's timer goes off */
 void A_timerinterrupt()
 {
-  //cout<<"Inside A_timerinterrupt\n";
-  timer_fin = BASE_RTT;
-  starttimer(0, timer_fin); 
-  //Check and send all messages that fall into the window
-  for (int i = send_base; (i < nextseqnum) && (i < send_base+window); i++){
-    tolayer3(0, sent_dataPkt[i]);
-  }
+  senders[get_flow()]->timerinterrupt();
 }  
 
+/* called when one of A's logical timers goes off */
+void A_timerinterrupt_id(int id)
+{
+  senders[get_flow()]->timerinterrupt_id(id);
+}
+
+/* called by the sampler (-S) for the state of A */
+void A_probe(struct probe *p)
+{
+  senders[get_flow()]->probe(p);
+}
+
 /* the following routine will be called once (only) before any other */
 /* entity A routines are called. You can use it to do any initialization */
 void A_init()
 {
-  //cout<<"Inside A_init\n";
-  timer_fin = BASE_RTT;
-  window = getwinsize();
+  //Create senders for all flows when called for the first one,
+  //after freeing those of any earlier run
+  if (get_flow() == 0){
+    for (int i = 0; i < nsenders; i++){
+      delete senders[i];
+    }
+    delete[] senders;
+    senders = new rdt_sender *[nsenders = get_num_flows()];
+  }
+  if (get_msg_size() <= SHORT_PAYLOAD){
+    senders[get_flow()] = new_sender<SHORT_PAYLOAD>(getwinsize());
+  }
+  else{
+    senders[get_flow()] = new_sender<PAYLOAD>(getwinsize());
+  }
 }
 
 /* Note that with simplex transfer from a-to-B, there is no B_output() */
@@ -199,48 +105,32 @@ void A_init()
 /* called from layer 3, when a packet arrives for layer 4 at B*/
 void B_input(struct pkt packet)
 {
-  struct pkt p_toLayer3;
-  char data_fromA[20];
-  
-  //Process if packet is not corrupt, and has expected seqnum
-  if (!check_corrupt(packet) && packet.seqnum == expectedseqnum){
-    
-    
-    //Send data from A to Layer 5
-    strncpy(data_fromA, packet.payload, 20);
-    tolayer5(1, data_fromA);
-    //cout<<"B_input data sent to layer 5\n";
-  
-    //Send ACK to A for packet received
-    p_toLayer3.seqnum = expectedseqnum;
-    p_toLayer3.acknum = expectedseqnum;
-    memset(p_toLayer3.payload,'\0', 20);
-    p_toLayer3.checksum = generate_checksum(p_toLayer3);
-    sent_ackPkt = p_toLayer3;
-    
-    tolayer3(1, p_toLayer3);
-    expectedseqnum++;
-
-    //cout<<"B_input ACK"<<expectedseqnum-1<<" sent to layer 3\n";  
-  }
-  
-  //In case of out of order delivery, discard packet and resend last ACK
-  else{
-    //cout<<"Retransmit last ACK:"<<sent_ackPkt.seqnum<<"\n";
-    tolayer3(1, sent_ackPkt);
-  }
+  receivers[get_flow()]->input(packet);
+}
+
+/* called by the sampler (-S) for the state of B */
+void B_probe(struct probe *p)
+{
+  receivers[get_flow()]->probe(p);
 }
 
 /* the following rouytine will be called once (only) before any other */
 /* entity B routines are called. You can use it to do any initialization */
 void B_init()
 {
-  //cout<<"Inside B_init\n";
-  //Initialize ACK0
-  struct pkt ack0; 
-  ack0.seqnum = expectedseqnum - 1;
-  ack0.acknum = expectedseqnum - 1;
-  memset(ack0.payload,'\0', 20);
-  ack0.checksum = generate_checksum(ack0);
-  sent_ackPkt = ack0;  
+  //Create receivers for all flows when called for the first one,
+  //after freeing those of any earlier run
+  if (get_flow() == 0){
+    for (int i = 0; i < nreceivers; i++){
+      delete receivers[i];
+    }
+    delete[] receivers;
+    receivers = new rdt_receiver *[nreceivers = get_num_flows()];
+  }
+  if (get_msg_size() <= SHORT_PAYLOAD){
+    receivers[get_flow()] = new_receiver<SHORT_PAYLOAD>(getwinsize());
+  }
+  else{
+    receivers[get_flow()] = new_receiver<PAYLOAD>(getwinsize());
+  }
 }
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/histogram.h"
+
+#define SUB  (1 << HIST_SUBBITS)   /* buckets below the first doubling */
+#define HALF (SUB / 2)             /* buckets in each doubling after it */
+
+/* bucket that u units fall in */
+static int bucket(unsigned long long u)
+{
+   int shift;
+
+   if (u < SUB)
+      return u;
+   shift = 63 - __builtin_clzll(u) - (HIST_SUBBITS-1);
+   return shift*HALF + (int)(u >> shift);
+}
+
+/* largest value, in units, that falls in bucket i */
+static double bucket_top(int i)
+{
+   int shift;
+
+   if (i < SUB)
+      return i;
+   shift = i/HALF - 1;
+   return (double)(((unsigned long long)(i - shift*HALF) + 1) << shift) - 1;
+}
+
+static void grow(struct histogram *h, int n)
+{
+   h->counts = (long long *)realloc(h->counts, n * sizeof(long long));
+   memset(h->counts + h->nbuckets, 0, (n - h->nbuckets) * sizeof(long long));
+   h->nbuckets = n;
+}
+
+void hist_record(struct histogram *h, double v)
+{
+   int i;
+
+   if (v < 0)
+      v = 0;
+   i = bucket((unsigned long long)(v / HIST_UNIT));
+   if (i >= h->nbuckets)
+      grow(h, i + HALF);
+   h->counts[i]++;
+   h->total++;
+   if (v > h->max)
+      h->max = v;
+}
+
+void hist_merge(struct histogram *to, struct histogram *from)
+{
+   int i;
+
+   if (from->nbuckets > to->nbuckets)
+      grow(to, from->nbuckets);
+   for (i = 0; i < from->nbuckets; i++)
+      to->counts[i] += from->counts[i];
+   to->total += from->total;
+   if (from->max > to->max)
+      to->max = from->max;
+}
+
+double hist_percentile(struct histogram *h, double p)
+{
+   long long want = (long long)(p / 100 * h->total + 0.5), seen = 0;
+   double v;
+   int i;
+
+   if (want < 1)
+      want = 1;
+   for (i = 0; i < h->nbuckets; i++) {
+      seen += h->counts[i];
+      if (seen >= want) {
+         v = bucket_top(i) * HIST_UNIT;
+         return v < h->max ? v : h->max;
+      }
+   }
+   return h->max;
+}
@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "../include/simulator.h"
+#include "../include/rdtsim.h"
+
+/*****************************************************************
+ The protocols of librdtsim.  Each is built into the library with
+ its routines renamed after it (abt_A_output() and so on), and the
+ routines the simulator calls pass each call on to the protocol of
+ the run.
+******************************************************************/
+
+#define PROTOCOL_ROUTINES(p) \
+   void p##_A_output(struct msg message); \
+   void p##_A_input(struct pkt packet); \
+   void p##_A_timerinterrupt(); \
+   void p##_A_timerinterrupt_id(int id); \
+   void p##_A_init(); \
+   void p##_A_probe(struct probe *pr); \
+   void p##_B_input(struct pkt packet); \
+   void p##_B_init(); \
+   void p##_B_probe(struct probe *pr);
+
+PROTOCOL_ROUTINES(abt)
+PROTOCOL_ROUTINES(gbn)
+PROTOCOL_ROUTINES(sr)
+PROTOCOL_ROUTINES(fec)
+
+struct protocol {
+   const char *name;
+   void  (*A_output)(struct msg message);
+   void  (*A_input)(struct pkt packet);
+   void  (*A_timerinterrupt)();
+   void  (*A_timerinterrupt_id)(int id);
+   void  (*A_init)();
+   void  (*A_probe)(struct probe *p);
+   void  (*B_input)(struct pkt packet);
+   void  (*B_init)();
+   void  (*B_probe)(struct probe *p);
+};
+
+#define PROTOCOL(p) { #p, p##_A_output, p##_A_input, p##_A_timerinterrupt, p##_A_timerinterrupt_id, \
+                      p##_A_init, p##_A_probe, p##_B_input, p##_B_init, p##_B_probe }
+
+static struct protocol protocols[] = {
+   PROTOCOL(abt),
+   PROTOCOL(gbn),
+   PROTOCOL(sr),
+   PROTOCOL(fec),
+};
+static struct protocol *proto = &protocols[0];
+
+int select_protocol(const char *name)
+{
+   unsigned int i;
+
+   for (i = 0; i < sizeof(protocols)/sizeof(protocols[0]); i++)
+      if (strcmp(protocols[i].name, name) == 0) {
+         proto = &protocols[i];
+         return 0;
+      }
+   return -1;
+}
+
+void A_output(struct msg message)  { proto->A_output(message); }
+void A_input(struct pkt packet)    { proto->A_input(packet); }
+void A_timerinterrupt()            { proto->A_timerinterrupt(); }
+void A_timerinterrupt_id(int id)   { proto->A_timerinterrupt_id(id); }
+void A_init()                      { proto->A_init(); }
+void A_probe(struct probe *p)      { proto->A_probe(p); }
+void B_input(struct pkt packet)    { proto->B_input(packet); }
+void B_init()                      { proto->B_init(); }
+void B_probe(struct probe *p)      { proto->B_probe(p); }
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/sampler.h"
+
+const char *sample_names[NSCOLUMNS] = {"sample", "events", "window", "inflight", "timeout",
+                                       "send_base", "recv_base", "delivered"};
+
+/* values of column c in a block: one per sample, or one per flow for each */
+static int column_size(int c, int nsamples, int nflows)
+{
+   return SC_PERFLOW(c) ? nsamples * nflows : nsamples;
+}
+
+/***************************** WRITING ****************************/
+static FILE *out = NULL;
+static float interval;
+static int   nflows;
+static long long *block[NSCOLUMNS];   /* samples of the block so far */
+static int   nsamples;
+static int   nextflow;                /* flow sample_flow() is given next */
+static unsigned char *bytes;          /* a column of the block, encoded */
+
+static void put_varint(FILE *f, unsigned long long v)
+{
+   while (v >= 0x80) {
+      putc((int)(v & 0x7f) | 0x80, f);
+      v >>= 7;
+   }
+   putc((int)v, f);
+}
+
+static int encode(unsigned char *to, long long v)
+{
+   unsigned long long z = (unsigned long long)v << 1 ^ (unsigned long long)(v >> 63);
+   int n = 0;
+
+   while (z >= 0x80) {
+      to[n++] = (unsigned char)(z & 0x7f) | 0x80;
+      z >>= 7;
+   }
+   to[n++] = (unsigned char)z;
+   return n;
+}
+
+static void flush_block()
+{
+   int c, i, n, stride;
+   long long *v;
+
+   if (nsamples == 0)
+      return;
+   put_varint(out, nsamples);
+   for (c = 0; c < NSCOLUMNS; c++) {
+      v = block[c];
+      stride = SC_PERFLOW(c) ? nflows : 1;
+      n = 0;
+      for (i = 0; i < column_size(c, nsamples, nflows); i++)
+         n += encode(bytes + n, i < stride ? v[i] : v[i] - v[i-stride]);
+      put_varint(out, n);
+      fwrite(bytes, 1, n, out);
+   }
+   nsamples = 0;
+}
+
+/* spec is "Interval:File" */
+int sampler_open(const char *spec, int flows)
+{
+   const char *colon = strchr(spec, ':');
+   char *end;
+   int c;
+
+   interval = strtof(spec, &end);
+   if (colon == NULL || end != colon || !(interval > 0) || colon[1] == '\0') {
+      fprintf(stderr, "Sampling needs Interval:File, with an interval above 0\n");
+      return -1;
+   }
+   if ((out = fopen(colon+1, "wb")) == NULL) {
+      perror(colon+1);
+      return -1;
+   }
+   nflows = flows;
+   for (c = 0; c < NSCOLUMNS; c++)
+      block[c] = (long long *)malloc(column_size(c, SAMPLE_BLOCK, nflows) * sizeof(long long));
+   bytes = (unsigned char *)malloc((size_t)SAMPLE_BLOCK * nflows * 10);
+
+   fwrite(SAMPLE_MAGIC, 1, strlen(SAMPLE_MAGIC), out);
+   fwrite(&interval, sizeof interval, 1, out);
+   put_varint(out, nflows);
+   put_varint(out, NSCOLUMNS);
+   for (c = 0; c < NSCOLUMNS; c++) {
+      fwrite(sample_names[c], 1, strlen(sample_names[c]) + 1, out);
+      putc(SC_PERFLOW(c), out);
+      put_varint(out, c == SC_TIMEOUT ? SAMPLE_SCALE : 1);
+   }
+   return 0;
+}
+
+float sampler_interval()
+{
+   return interval;
+}
+
+void sample_begin(long long k, int events)
+{
+   if (nsamples == SAMPLE_BLOCK)
+      flush_block();
+   block[SC_SAMPLE][nsamples] = k;
+   block[SC_EVENTS][nsamples] = events;
+   nsamples++;
+   nextflow = 0;
+}
+
+void sample_flow(struct probe *p, int delivered)
+{
+   int i = (nsamples-1) * nflows + nextflow++;
+
+   block[SC_WINDOW][i] = p->window;
+   block[SC_INFLIGHT][i] = p->inflight;
+   block[SC_TIMEOUT][i] = llround((double)p->timeout * SAMPLE_SCALE);
+   block[SC_SENDBASE][i] = p->send_base;
+   block[SC_RECVBASE][i] = p->recv_base;
+   block[SC_DELIVERED][i] = delivered;
+}
+
+void sampler_close()
+{
+   if (out == NULL)
+      return;
+   flush_block();
+   fclose(out);
+   out = NULL;
+}
+
+/***************************** READING ****************************/
+static int get_varint(FILE *f, unsigned long long *v)
+{
+   int b, shift = 0;
+
+   *v = 0;
+   do {
+      if ((b = getc(f)) == EOF || shift > 63)
+         return -1;
+      *v |= (unsigned long long)(b & 0x7f) << shift;
+      shift += 7;
+   } while (b & 0x80);
+   return 0;
+}
+
+int sample_read_open(struct sample_file *sf, const char *path)
+{
+   char magic[sizeof SAMPLE_MAGIC];
+   unsigned long long v;
+   int c, i, ch;
+
+   memset(sf, 0, sizeof *sf);
+   if ((sf->f = fopen(path, "rb")) == NULL) {
+      perror(path);
+      return -1;
+   }
+   if (fread(magic, 1, strlen(SAMPLE_MAGIC), sf->f) != strlen(SAMPLE_MAGIC)
+       || memcmp(magic, SAMPLE_MAGIC, strlen(SAMPLE_MAGIC)) != 0
+       || fread(&sf->interval, sizeof sf->interval, 1, sf->f) != 1)
+      goto bad;
+   if (get_varint(sf->f, &v) != 0 || v == 0 || v > 1 << 20)
+      goto bad;
+   sf->nflows = (int)v;
+   if (get_varint(sf->f, &v) != 0 || v > NSCOLUMNS)
+      goto bad;
+   sf->ncols = (int)v;
+   for (c = 0; c < sf->ncols; c++) {
+      for (i = 0; (ch = getc(sf->f)) > 0; i++)
+         if (i < (int)sizeof sf->names[c] - 1)
+            sf->names[c][i] = ch;
+      if (ch == EOF || (sf->perflow[c] = getc(sf->f)) == EOF
+          || get_varint(sf->f, &v) != 0 || v == 0)
+         goto bad;
+      sf->scale[c] = (long long)v;
+   }
+   return 0;
+
+bad:
+   fprintf(stderr, "%s is not a sample file\n", path);
+   fclose(sf->f);
+   return -1;
+}
+
+int sample_read_block(struct sample_file *sf, const int *want)
+{
+   unsigned long long v, z;
+   long n, end;
+   int c, i, size, stride;
+   long long *val;
+
+   if (get_varint(sf->f, &v) != 0)
+      return feof(sf->f) ? 0 : -1;
+   if (v == 0 || v > SAMPLE_BLOCK)
+      return -1;
+   sf->nsamples = (int)v;
+   for (c = 0; c < sf->ncols; c++) {
+      if (get_varint(sf->f, &v) != 0)
+         return -1;
+      n = (long)v;
+      if (want != NULL && !want[c]) {
+         if (fseek(sf->f, n, SEEK_CUR) != 0)
+            return -1;
+         continue;
+      }
+      stride = sf->perflow[c] ? sf->nflows : 1;
+      size = sf->nsamples * stride;
+      sf->values[c] = val = (long long *)realloc(sf->values[c], size * sizeof(long long));
+      end = ftell(sf->f) + n;
+      for (i = 0; i < size; i++) {
+         if (get_varint(sf->f, &z) != 0)
+            return -1;
+         val[i] = (long long)(z >> 1) ^ -(long long)(z & 1);
+         if (i >= stride)
+            val[i] += val[i-stride];
+      }
+      if (ftell(sf->f) != end)
+         return -1;
+   }
+   return sf->nsamples;
+}
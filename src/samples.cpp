@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/sampler.h"
+
+/*****************************************************************
+ Reader for the files of -S: prints the samples as CSV, a line per
+ flow and sample, with the time and flow first and then the columns
+ named on the command line, or all of them.  Only the columns asked
+ for are decoded.
+******************************************************************/
+
+int main(int argc, char **argv)
+{
+   struct sample_file sf;
+   int want[NSCOLUMNS] = {0};
+   int order[NSCOLUMNS];
+   int ncols = 0, c, i, k, f, n;
+   long long v;
+
+   if (argc < 2) {
+      fprintf(stderr, "Usage:\n %s File [Column ...]\n", argv[0]);
+      return -1;
+   }
+   if (sample_read_open(&sf, argv[1]) != 0)
+      return -1;
+   if (argc == 2)
+      for (c = 0; c < sf.ncols; c++) {
+         want[c] = 1;
+         order[ncols++] = c;
+      }
+   for (i = 2; i < argc; i++) {
+      for (c = 0; c < sf.ncols && strcmp(sf.names[c], argv[i]) != 0; c++)
+         ;
+      if (c == sf.ncols) {
+         fprintf(stderr, "No column %s in %s; it has", argv[i], argv[1]);
+         for (c = 0; c < sf.ncols; c++)
+            fprintf(stderr, " %s", sf.names[c]);
+         fprintf(stderr, "\n");
+         return -1;
+      }
+      want[c] = 1;
+      order[ncols++] = c;
+   }
+   want[SC_SAMPLE] = 1;
+
+   printf("time,flow");
+   for (i = 0; i < ncols; i++)
+      printf(",%s", sf.names[order[i]]);
+   printf("\n");
+   while ((n = sample_read_block(&sf, want)) > 0)
+      for (k = 0; k < n; k++)
+         for (f = 0; f < sf.nflows; f++) {
+            printf("%g,%d", sf.values[SC_SAMPLE][k] * (double)sf.interval, f);
+            for (i = 0; i < ncols; i++) {
+               c = order[i];
+               v = sf.values[c][sf.perflow[c] ? k*sf.nflows + f : k];
+               if (sf.scale[c] == 1)
+                  printf(",%lld", v);
+               else
+                  printf(",%g", (double)v / sf.scale[c]);
+            }
+            printf("\n");
+         }
+   if (n < 0) {
+      fprintf(stderr, "%s is damaged\n", argv[1]);
+      return -1;
+   }
+   return 0;
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../include/backend.h"
+#include "../include/spsc_ring.h"
+
+/*****************************************************************
+ SHARED-MEMORY BACKEND: A and B run as two processes joined by a
+ lock-free ring in each direction, in a shared anonymous mapping.
+ Packets are lost or corrupted as they are put on a ring, and a full
+ ring drops them.  Both sides poll their ring; no system call is made
+ while packets are flowing.
+******************************************************************/
+
+#define BATCH 64           /* packets taken from a ring at once */
+
+struct shared {
+   struct ring ring[2];    /* ring[A] carries packets from A to B */
+   int done;               /* set by A once every msg is delivered or dropped */
+   int delivered;          /* msgs B has passed to layer 5 so far */
+   /* counts kept by B, filled in when it exits */
+   int B_transport, ntolayer3, nlost, ncorrupt, nfull;
+};
+struct shared *sh;
+
+int   nreads;              /* reads that found packets on a ring */
+int   nrecvd;              /* packets taken from the rings */
+
+void send_packet(int AorB, struct wire *w)
+{
+   if (!ring_put(&sh->ring[AorB], w))
+      nfull++;
+}
+
+/* deliver what is waiting on the ring towards AorB; returns how many */
+int receive(int AorB)
+{
+   struct wire in[BATCH];
+   int i, n;
+
+   if ((n = ring_get(&sh->ring[1-AorB], in, BATCH)) == 0)
+      return 0;
+   nreads++;
+   nrecvd += n;
+   for (i = 0; i < n; i++) {
+      if (in[i].flow < 0 || in[i].flow >= nflows)
+         continue;
+      cur_flow = in[i].flow;
+      if (AorB == A)
+         A_input(in[i].pkt);
+      else {
+         B_transport += 1;
+         B_input(in[i].pkt);
+      }
+   }
+   return n;
+}
+
+void run_B()
+{
+   while (!__atomic_load_n(&sh->done, __ATOMIC_ACQUIRE)) {
+      run_deadlines();
+      if (receive(B) > 0)
+         __atomic_store_n(&sh->delivered, B_application, __ATOMIC_RELEASE);
+      else
+         sched_yield();
+   }
+   sh->B_transport = B_transport;
+   sh->ntolayer3 = ntolayer3;
+   sh->nlost = nlost;
+   sh->ncorrupt = ncorrupt;
+   sh->nfull = nfull;
+}
+
+void run_A()
+{
+   double idle = 0;
+
+   while (1) {
+      run_deadlines();
+      B_application = __atomic_load_n(&sh->delivered, __ATOMIC_ACQUIRE);
+      if (finished() || out_of_time())
+         return;
+      if (receive(A) > 0)
+         idle = now();
+      else if (now() - idle > 5e6 / usec_per_unit) {
+         fprintf(stderr, "No packets for 5 seconds, giving up\n");
+         return;
+      }
+      else
+         sched_yield();
+   }
+}
+
+int main(int argc, char **argv)
+{
+   double elapsed;
+   pid_t pid;
+
+   setup(argc, argv);
+   sh = (struct shared *)mmap(NULL, sizeof(struct shared), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (sh == MAP_FAILED) {
+      perror("mmap");
+      exit(-1);
+   }
+   start_clock();
+   fflush(stdout);
+   if ((pid = fork()) < 0) {
+      perror("fork");
+      exit(-1);
+   }
+   if (pid == 0) {
+      seed_random(B);
+      run_B();
+      fflush(stdout);
+      _exit(0);
+   }
+
+   start_arrivals();
+   run_A();
+   elapsed = now();
+   __atomic_store_n(&sh->done, 1, __ATOMIC_RELEASE);
+   waitpid(pid, NULL, 0);
+
+   B_application = sh->delivered;
+   B_transport = sh->B_transport;
+   ntolayer3 += sh->ntolayer3;
+   nlost += sh->nlost;
+   ncorrupt += sh->ncorrupt;
+   nfull += sh->nfull;
+   report(elapsed);
+   printf("[PA2]Packets per ring read at A: %f[/PA2]\n", nreads > 0 ? (double)nrecvd / nreads : 0.0);
+   return 0;
+}
@@ -1,28 +1,134 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
-#include <ctype.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "../include/simulator.h"
-
-/* Statistics */
-int A_application = 0;
-int A_transport = 0;
-int B_application = 0;
-int B_transport = 0;
+#include "../include/common.h"
+#include "../include/workload.h"
+#include "../include/topology.h"
+#include "../include/histogram.h"
+#include "../include/sink.h"
+#include "../include/transfer.h"
+#include "../include/timerwheel.h"
+#include "../include/sampler.h"
+#include "../include/chrometrace.h"
+#include "../include/rdtsim.h"
+
+/* Statistics, kept by each thread of a parallel run (-j) and added */
+/* up at the end                                                    */
+thread_local int A_application = 0;
+thread_local int A_transport = 0;
+thread_local int B_application = 0;
+thread_local int B_transport = 0;
 
 int win_size;
 
 int TRACE = 1;             /* for my debugging */
-int nsim = 0;              /* number of messages from 5 to 4 so far */
+thread_local int nsim = 0; /* number of messages from 5 to 4 so far */
 int nsimmax = 0;           /* number of msgs to generate, then stop */
-float time_local = 0;
+thread_local float time_local = 0;
 float lossprob;            /* probability that a packet is dropped  */
 float corruptprob;         /* probability that one bit is packet is flipped */
 float lambda;              /* arrival rate of messages from layer 5 */
-int   ntolayer3;           /* number sent into layer 3 */
-int   nlost;               /* number lost in media */
-int ncorrupt;              /* number corrupted by media*/
+struct workload *workload; /* generator of messages from layer 5 */
+const char *wlspec = "uniform"; /* and its name and arguments */
+struct sink *sink;         /* where B's layer 5 puts delivered msgs */
+const char *transferspec = NULL; /* In:Out of a file transfer, NULL for none */
+thread_local int ntolayer3; /* number sent into layer 3 */
+thread_local int nlost;     /* number lost in media */
+thread_local int ncorrupt;  /* number corrupted by media*/
+
+/* Flows: each flow is an independent A->B pair running its own copy */
+/* of the protocol.  All flows share the links of the topology.       */
+struct flow {
+   float *msgtime;         /* time each msg was passed from layer 5 to A */
+   float *msgsent;         /* time each msg was first sent by A */
+   char  *msgdropped;      /* msgs discarded by A because its queue was full */
+   char  *msglen;          /* bytes used in each msg */
+   int   maxmsgs;          /* size of msgtime, msgsent, msgdropped and msglen */
+   int   application;      /* msgs passed from layer 5 to A */
+   int   next;             /* index of next msg waiting to be sent by A */
+   int   sent;             /* number of msgs sent by A */
+   int   dropped;          /* number of msgs discarded by A */
+   int   queued;           /* msgs accepted by A but not yet sent */
+   int   maxqueued;        /* largest value of queued */
+   double queuearea;       /* integral of queued over time */
+   float queuetime;        /* time queued last changed */
+   double queuedelay;      /* total time msgs spent waiting at A */
+   float maxqueuedelay;    /* longest time a msg spent waiting at A */
+   int   delivered;        /* msgs passed to layer 5 at B */
+   int   nextdeliver;      /* index of next msg expected at layer 5 of B */
+   double latency;         /* total time from layer 5 of A to layer 5 of B */
+   int   arrival_pending;  /* an arrival from layer 5 is on the event list */
+   float cwnd;             /* congestion window of A, under -C */
+   double cwndarea;        /* integral of cwnd over time */
+   float cwndtime;         /* time cwnd last changed */
+   struct event *timer[2]; /* running timer of A and B, if any */
+   struct arrival *arrivals; /* msgs from layer 5 planned for a parallel run */
+   int   narrivals, maxarrivals;
+   int   allplanned;       /* the workload has no msgs after the planned ones */
+   int   nextarrival;      /* index of next planned msg to put on the event list */
+};
+struct arrival {
+   float time;
+   int   len;
+};
+struct flow *flows;
+int   nflows = 1;          /* number of flows */
+thread_local int cur_flow = 0; /* flow of the event being processed */
+
+/* Network: the nodes and links that packets cross between A and B. */
+struct topology *topo;
+const char *topofile = NULL; /* topology file, NULL for a single link */
+void forward(int n, struct pkt *mypktptr, int AorB);
+int entity_node(int f, int AorB);
+float bottleneck_rate = 0; /* packets per time unit, 0 for no bottleneck */
+int   queue_limit = 0;     /* bottleneck queue size, 0 for unlimited */
+
+/* the simulator's copy of a packet while it crosses the network */
+struct netpkt {
+   struct pkt pkt;         /* first, so the copy is passed around as a struct pkt * */
+   float sent;             /* time it was passed to layer 3 */
+   long long traceid;      /* its span in the -X trace */
+};
+thread_local float lastsent; /* time the packet being delivered to B was sent */
+
+/* Delays of the msgs delivered, from layer 5 of A to layer 5 of B, */
+/* and the parts of them spent queued at A, crossing the network    */
+/* and waiting for retransmissions.                                 */
+#define LATENCY        0
+#define QUEUEING       1
+#define TRANSMISSION   2
+#define RETRANSMISSION 3
+#define NDELAYS        4
+const char *delaynames[NDELAYS] = {"Latency", "Queueing delay", "Transmission delay", "Retransmission delay"};
+struct histogram alldelays[NDELAYS];
+thread_local struct histogram *delays = alldelays; /* where deliveries are recorded */
+
+/* Random numbers come from a stream per node, for what happens at   */
+/* the node, and a stream per flow, for its msgs from layer 5.  What  */
+/* a node draws then does not depend on the order events elsewhere   */
+/* are simulated in, so a parallel run (-j) repeats the sequential    */
+/* run with the same seed, whatever the number of threads.            */
+#define STREAMSTATE 128
+thread_local struct random_data *rng = NULL; /* stream in use, NULL for rand() */
+struct random_data *flowrng = NULL; /* stream of each flow's msgs */
+char  *flowrngstate = NULL;
+
+/* start an independent stream of random numbers */
+void init_stream(struct random_data *r, char *state, unsigned int seed)
+{
+  memset(r, 0, sizeof(struct random_data));
+  initstate_r(seed, state, STREAMSTATE, r);
+}
 
 /****************************************************************************/
 /* jimsrand(): return a float in range [0,1].  The routine below is used to */
@@ -33,6 +139,12 @@ float jimsrand()
 {
   double mmm = 2147483647;   /* largest int  - MACHINE DEPENDENT!!!!!!!!   */
   float x;                   /* individual students may need to change mmm */ 
+  int32_t r;
+  if (rng != NULL) {
+    random_r(rng, &r);
+    x = r/mmm;
+  }
+  else
   x = rand()/mmm;            /* x should be uniform in [0,1] */
   return(x);
 }  
@@ -60,6 +172,8 @@ to, and you defeinitely should not have to modify
 #define  TIMER_INTERRUPT 0  
 #define  FROM_LAYER5     1
 #define  FROM_LAYER3     2
+#define  HOP_ARRIVAL     3
+#define  TIMER_WHEEL     4   /* the logical timers need running */
 
 #define  OFF             0
 #define  ON              1
@@ -71,48 +185,225 @@ struct event {
    float evtime;           /* event time */
    int evtype;             /* event type code */
    int eventity;           /* entity where event occurs */
+   int evflow;             /* flow the event belongs to */
+   int evnode;             /* node the event happens at */
    struct pkt *pktptr;     /* ptr to packet (if any) assoc w/ this event */
-   struct event *prev;
-   struct event *next;
+   int msglen;             /* bytes in msg from layer 5 (if any) */
+   int evorigin;           /* node that scheduled it */
+   unsigned int evseq;     /* order it was scheduled in there, to break ties in evtime */
+   int heappos;            /* position in the event heap */
  };
-struct event *evlist = NULL;   /* the event list */
 
+/* The event list is a binary heap ordered by event time.  Events with */
+/* equal times come out in the order of the nodes that scheduled them, */
+/* and of those from one node the most recently scheduled first, as    */
+/* they did from the original sorted list.  That order does not depend */
+/* on how the events of different nodes interleave, so it is the same  */
+/* whether the nodes share one list or have one each (-j).             */
+struct evlist {
+   struct event **heap;    /* the events */
+   int count;              /* number of events on the list */
+   int size;               /* size of heap */
+};
+struct evlist mainlist;    /* the event list */
+thread_local struct evlist *evlist = &mainlist; /* list of the node being simulated */
+
+/* Every node of the topology keeps what its events work on: its      */
+/* random stream, the logical timers of the entities on it and the    */
+/* count of events it has scheduled.  In a parallel run it is also a  */
+/* partition with an event list of its own.  Packets sent from a node */
+/* are posted to the node they arrive at, which takes them in at the  */
+/* end of the window; a window posts to one set of buffers while the  */
+/* packets of the window before are taken from the other.             */
+struct evbuf {
+   struct event **ev;
+   int count, size;
+};
+
+struct partition {
+   struct evlist events;   /* events at this node, in a parallel run */
+   struct evbuf *posted[2]; /* events posted by each node, by window parity */
+   unsigned int seq;       /* events scheduled here so far */
+   struct wheel timers;    /* logical timers of the entities here */
+   struct event *wheelev;  /* event for the next time the wheel needs running */
+   struct random_data rng; /* random numbers for this node */
+   char  rngstate[STREAMSTATE];
+   float last;             /* time of the latest event simulated */
+   struct histogram delays[NDELAYS]; /* delays of msgs delivered at this node */
+};
+struct partition *parts = NULL; /* one per node */
+thread_local struct partition *part = NULL; /* node being simulated */
+int   nthreads = 0;        /* threads of a parallel run, 0 to run sequentially */
+float lookahead;           /* shortest delay of any link */
+float cutoff;              /* time of the last msg from layer 5, INFINITY until known */
+thread_local int window = 0;          /* parity of the window being simulated */
+thread_local float postmin = INFINITY; /* earliest event posted in it */
+
+int evbefore(struct event *p, struct event *q)
+{
+   if (p->evtime != q->evtime)
+      return p->evtime < q->evtime;
+   if (p->evorigin != q->evorigin)
+      return p->evorigin < q->evorigin;
+   return p->evseq > q->evseq;
+}
 
-void insertevent(struct event *p)
+void evswap(int i, int j)
+{
+   struct event **heap = evlist->heap;
+   struct event *t = heap[i];
+   heap[i] = heap[j];
+   heap[j] = t;
+   heap[i]->heappos = i;
+   heap[j]->heappos = j;
+}
+
+void evsiftup(int i)
+{
+   struct event **heap = evlist->heap;
+
+   while (i > 0 && evbefore(heap[i], heap[(i-1)/2])) {
+      evswap(i, (i-1)/2);
+      i = (i-1)/2;
+   }
+}
+
+void evsiftdown(int i)
+{
+   struct event **heap = evlist->heap;
+   int child;
+
+   while ((child = 2*i+1) < evlist->count) {
+      if (child+1 < evlist->count && evbefore(heap[child+1], heap[child]))
+         child++;
+      if (!evbefore(heap[child], heap[i]))
+         break;
+      evswap(i, child);
+      i = child;
+   }
+}
+
+/* put event p, already scheduled, on the event list */
+void addevent(struct event *p)
+{
+   if (evlist->count == evlist->size) {
+      evlist->size = evlist->size ? 2*evlist->size : 64;
+      evlist->heap = (struct event **)realloc(evlist->heap, evlist->size * sizeof(struct event *));
+   }
+   p->heappos = evlist->count;
+   evlist->heap[evlist->count++] = p;
+   evsiftup(p->heappos);
+}
+
+/* the node being simulated schedules event p */
+void stamp_event(struct event *p)
 {
-   struct event *q,*qold;
+   p->evorigin = part - parts;
+   p->evseq = part->seq++;
+}
 
+void insertevent(struct event *p)
+{
    if (TRACE>2) {
       printf("            INSERTEVENT: time is %lf\n",time_local);
       printf("            INSERTEVENT: future time will be %lf\n",p->evtime); 
       }
-   q = evlist;     /* q points to header of list in which p struct inserted */
-   if (q==NULL) {   /* list is empty */
-        evlist=p;
-        p->next=NULL;
-        p->prev=NULL;
-        }
-     else {
-        for (qold = q; q !=NULL && p->evtime > q->evtime; q=q->next)
-              qold=q; 
-        if (q==NULL) {   /* end of list */
-             qold->next = p;
-             p->prev = qold;
-             p->next = NULL;
-             }
-           else if (q==evlist) { /* front of list */
-             p->next=evlist;
-             p->prev=NULL;
-             p->next->prev=p;
-             evlist = p;
-             }
-           else {     /* middle of list */
-             p->next=q;
-             p->prev=q->prev;
-             q->prev->next=p;
-             q->prev=p;
-             }
-         }
+   stamp_event(p);
+   addevent(p);
+}
+
+/* take event p off the event list */
+void removeevent(struct event *p)
+{
+   int i = p->heappos;
+
+   evlist->count--;
+   if (i == evlist->count)
+      return;
+   evlist->heap[i] = evlist->heap[evlist->count];
+   evlist->heap[i]->heappos = i;
+   evsiftup(i);
+   evsiftdown(evlist->heap[i]->heappos);
+}
+
+/* take the earliest event off the event list */
+struct event *nextevent()
+{
+   struct event *p;
+
+   if (evlist->count == 0)
+      return NULL;
+   p = evlist->heap[0];
+   removeevent(p);
+   return p;
+}
+
+/* simulate at node n from now on */
+void enter_node(int n)
+{
+   part = &parts[n];
+   rng = &part->rng;
+   if (nthreads > 0)
+      evlist = &part->events;
+}
+
+/* keep the event that runs the logical timers of this node at the */
+/* next time their wheel needs running                            */
+void arm_wheel()
+{
+   struct event *evptr = part->wheelev;
+   float when = wheel_next(&part->timers);
+
+   if (evptr != NULL) {
+      if (evptr->evtime == when)
+         return;
+      removeevent(evptr);
+   }
+   if (when == INFINITY) {
+      free(evptr);
+      part->wheelev = NULL;
+      return;
+   }
+   if (evptr == NULL) {
+      evptr = (struct event *)malloc(sizeof(struct event));
+      evptr->evtype = TIMER_WHEEL;
+      evptr->eventity = A;
+      evptr->evflow = cur_flow;
+      evptr->evnode = part - parts;
+   }
+   evptr->evtime = when;
+   part->wheelev = evptr;
+   insertevent(evptr);
+}
+
+/* the node being simulated posts event p for node n */
+void post_event(int n, struct event *p)
+{
+   struct evbuf *b = &parts[n].posted[window][part - parts];
+
+   if (b->count == b->size) {
+      b->size = b->size ? 2*b->size : 16;
+      b->ev = (struct event **)realloc(b->ev, b->size * sizeof(struct event *));
+   }
+   stamp_event(p);
+   b->ev[b->count++] = p;
+   if (p->evtime < postmin)
+      postmin = p->evtime;
+}
+
+/* put the events posted for node n in this window on its list */
+void take_posted(int n)
+{
+   struct evbuf *b;
+   int src, i;
+
+   evlist = &parts[n].events;
+   for (src = 0; src < topo->nnodes; src++) {
+      b = &parts[n].posted[window][src];
+      for (i = 0; i < b->count; i++)
+         addevent(b->ev[i]);
+      b->count = 0;
+   }
 }
 
 
@@ -123,23 +414,43 @@ void insertevent(struct event *p)
 /*  The next set of routines handle the event list   */
 /*****************************************************/
 
-void generate_next_arrival()
+void generate_next_arrival(int f)
 {
-   double x,log(),ceil();
+   double x;
    struct event *evptr;
-//    //char *malloc();
-   float ttime;
-   int tempint;
+   struct flow *fp = &flows[f];
+   float when;
+   int len;
+
+   /* a backlogged source only adds a msg once A has sent everything */
+   if (workload->backlogged && (flows[f].arrival_pending || flows[f].queued > 0))
+       return;
 
    if (TRACE>2)
        printf("          GENERATE NEXT ARRIVAL: creating new arrival\n");
 
-   x = lambda*jimsrand()*2;  /* x is uniform on [0,2*lambda] */
-                             /* having mean of lambda        */
+   if (nthreads > 0) {       /* replay the msgs planned before the run */
+      if (fp->nextarrival == fp->narrivals)
+         return;
+      when = fp->arrivals[fp->nextarrival].time;
+      len = fp->arrivals[fp->nextarrival++].len;
+   }
+   else {
+      rng = &flowrng[f];
+      x = workload->next_arrival(f, time_local, &len);
+      rng = &part->rng;
+      if (x < 0)             /* workload has no more msgs */
+         return;
+      when = time_local + x;
+   }
 
    evptr = (struct event *)malloc(sizeof(struct event));
-   evptr->evtime =  time_local + x;
+   evptr->evtime =  when;
    evptr->evtype =  FROM_LAYER5;
+   evptr->evflow = f;
+   evptr->evnode = topo->anode[f];
+   evptr->msglen = len;
+   flows[f].arrival_pending = 1;
    if (BIDIRECTIONAL && (jimsrand()>0.5) )
       evptr->eventity = B;
     else
@@ -151,11 +462,183 @@ void generate_next_arrival()
 
 
 
+/* Work out every msg layer 5 passes down in a parallel run before it  */
+/* starts, each flow drawing from its stream as it would during the   */
+/* run.  The flows are planned past a horizon with at least nsimmax   */
+/* msgs before it, the threads sharing them out; the run then takes   */
+/* every msg up to the time of the nsimmax-th, cutoff, as the         */
+/* sequential run does.                                               */
+float horizon;             /* time every flow is planned past */
+
+struct planner {
+   pthread_t thread;
+   int   first, last;      /* flows first to last-1 are this thread's */
+   int   min;              /* msgs each flow needs at least */
+};
+
+/* plan the msgs of the planner's flows until each has min of them */
+/* and is past the horizon, or has no more                        */
+void *plan_flows(void *arg)
+{
+   struct planner *pl = (struct planner *)arg;
+   struct flow *fp;
+   float now;
+   double x;
+   int f, len;
+
+   for (f = pl->first; f < pl->last; f++) {
+      fp = &flows[f];
+      rng = &flowrng[f];
+      while (!fp->allplanned && (fp->narrivals < pl->min
+             || fp->arrivals[fp->narrivals-1].time <= horizon)) {
+         now = fp->narrivals > 0 ? fp->arrivals[fp->narrivals-1].time : 0;
+         if ((x = workload->next_arrival(f, now, &len)) < 0) {
+            fp->allplanned = 1;
+            break;
+         }
+         if (fp->narrivals == fp->maxarrivals) {
+            fp->maxarrivals = fp->maxarrivals ? 2*fp->maxarrivals : 64;
+            fp->arrivals = (struct arrival *)realloc(fp->arrivals, fp->maxarrivals * sizeof(struct arrival));
+         }
+         fp->arrivals[fp->narrivals].time = now + x;
+         fp->arrivals[fp->narrivals++].len = len;
+      }
+   }
+   rng = NULL;
+   return NULL;
+}
+
+void plan_in_parallel(int min)
+{
+   struct planner *planners = (struct planner *)calloc(nthreads, sizeof(struct planner));
+   int i;
+
+   for (i = 0; i < nthreads; i++) {
+      planners[i].first = i * nflows / nthreads;
+      planners[i].last = (i+1) * nflows / nthreads;
+      planners[i].min = min;
+      if (i > 0)
+         pthread_create(&planners[i].thread, NULL, plan_flows, &planners[i]);
+   }
+   plan_flows(&planners[0]);
+   for (i = 1; i < nthreads; i++)
+      pthread_join(planners[i].thread, NULL);
+   free(planners);
+}
+
+/* msgs of flow fp planned for time t or before */
+int planned_by(struct flow *fp, float t)
+{
+   int n = fp->narrivals;
+
+   while (n > 0 && fp->arrivals[n-1].time > t)
+      n--;
+   return n;
+}
+
+/* the k-th smallest of the n times in a[], which it reorders */
+float kth_smallest(float *a, int n, int k)
+{
+   int lo = 0, hi = n-1, i, j;
+   float pivot, t;
+
+   while (lo < hi) {
+      pivot = a[(lo+hi)/2];
+      for (i = lo, j = hi; i <= j; ) {
+         while (a[i] < pivot)
+            i++;
+         while (a[j] > pivot)
+            j--;
+         if (i <= j) {
+            t = a[i];
+            a[i++] = a[j];
+            a[j--] = t;
+         }
+      }
+      if (k <= j)
+         hi = j;
+      else if (k >= i)
+         lo = i;
+      else
+         break;
+   }
+   return a[k];
+}
+
+void plan_arrivals()
+{
+   struct flow *fp;
+   float *times;
+   int f, n, k, total, allplanned;
+
+   if (nsimmax == 0)
+      return;
+   horizon = -INFINITY;
+   plan_in_parallel((nsimmax + nflows - 1) / nflows);
+   horizon = 0;
+   for (f = 0; f < nflows; f++)
+      if (flows[f].narrivals > 0 && flows[f].arrivals[flows[f].narrivals-1].time > horizon)
+         horizon = flows[f].arrivals[flows[f].narrivals-1].time;
+   while (1) {
+      plan_in_parallel(0);
+      total = 0;
+      allplanned = 1;
+      for (f = 0; f < nflows; f++) {
+         total += planned_by(&flows[f], horizon);
+         allplanned &= flows[f].allplanned;
+      }
+      if (total >= nsimmax || allplanned)
+         break;
+      horizon = horizon > 0 ? 2*horizon : 1;
+   }
+
+   if (total >= nsimmax) {
+      times = (float *)malloc(total * sizeof(float));
+      for (f = 0, total = 0; f < nflows; f++)
+         for (n = 0, k = planned_by(&flows[f], horizon); n < k; n++)
+            times[total++] = flows[f].arrivals[n].time;
+      cutoff = kth_smallest(times, total, nsimmax-1);
+      free(times);
+   }
+
+   /* room for every msg up front, so A never moves it while B reads it */
+   for (f = 0; f < nflows; f++) {
+      fp = &flows[f];
+      fp->narrivals = planned_by(fp, cutoff);
+      fp->maxmsgs = fp->narrivals;
+      fp->msgtime = (float *)malloc(fp->narrivals * sizeof(float));
+      fp->msgsent = (float *)malloc(fp->narrivals * sizeof(float));
+      fp->msgdropped = (char *)calloc(fp->narrivals, sizeof(char));
+      fp->msglen = (char *)malloc(fp->narrivals * sizeof(char));
+   }
+}
+
+/* give every node and every flow its stream */
+void init_partitions(int seed)
+{
+   int n, f;
+
+   parts = (struct partition *)calloc(topo->nnodes, sizeof(struct partition));
+   for (n = 0; n < topo->nnodes; n++) {
+      if (nthreads > 0) {
+         parts[n].posted[0] = (struct evbuf *)calloc(topo->nnodes, sizeof(struct evbuf));
+         parts[n].posted[1] = (struct evbuf *)calloc(topo->nnodes, sizeof(struct evbuf));
+      }
+      init_stream(&parts[n].rng, parts[n].rngstate, seed ^ (0x9e3779b9u * (n+1)));
+   }
+   flowrng = (struct random_data *)malloc(nflows * sizeof(struct random_data));
+   flowrngstate = (char *)malloc(nflows * STREAMSTATE);
+   for (f = 0; f < nflows; f++)
+      init_stream(&flowrng[f], &flowrngstate[f*STREAMSTATE], seed ^ (0x85ebca6bu * (f+1)));
+   cutoff = nsimmax != 0 ? INFINITY : -INFINITY;
+   if (nthreads > 0)
+      plan_arrivals();
+}
+
 void init(int seed)                         /* initialize the simulator */
 {
   int i;
   float sum, avg;
-  float jimsrand();
   
   /*
    printf("-----  Stop and Wait Network Simulator Version 1.1 -------- \n\n");
@@ -187,8 +670,16 @@ void init(int seed)                         /* initialize the simulator */
    nlost = 0;
    ncorrupt = 0;
 
+   flows = (struct flow *)calloc(nflows, sizeof(struct flow));
+   init_partitions(seed);
+
    time_local=0;                    /* initialize time to 0.0 */
-   generate_next_arrival();     /* initialize event list */
+   for (i=0; i<nflows; i++) {
+      enter_node(topo->anode[i]);
+      generate_next_arrival(i);     /* initialize event list */
+   }
+   evlist = &mainlist;
+   rng = NULL;
 }
 
 
@@ -207,108 +698,71 @@ void init(int seed)                         /* initialize the simulator */
 //int   nlost;               /* number lost in media */
 //int ncorrupt;              /* number corrupted by media*/
 
-/**
- * Checks if the array pointed to by input holds a valid number.
- *
- * @param  input char* to the array holding the value.
- * @return TRUE or FALSE
- */
-int isNumber(char *input)
-{
-    while (*input){
-        if (!isdigit(*input))
-            return 0;
-        else
-            input += 1;
-    }
-
-    return 1;
-}
-
-int read_arg_int(char c)
+/* track the number of msgs waiting at A, integrated over time */
+void update_queue(struct flow *fp, int change)
 {
-	if(!isNumber(optarg)) {
-		fprintf(stderr, "Invalid value for -%c\n", c);
-		exit(-1);
-	}
-	return atoi(optarg);	
+   fp->queuearea += (double)fp->queued * (time_local - fp->queuetime);
+   fp->queuetime = time_local;
+   fp->queued += change;
 }
 
-float read_arg_float(char c)
+/* record the delays of msg number n of flow fp, delivered now.  The   */
+/* time after the copy that arrived was sent is transmission delay;    */
+/* the time from the first send to that copy is retransmission delay.  */
+/* Msgs held at B for an earlier one count that wait as retransmission */
+/* delay too, since it is what the lost packet costs them.             */
+void record_delivery(struct flow *fp, int n)
 {
-	float val = atof(optarg);
-	if(val < 0.0 || val > 1.0){
-		fprintf(stderr, "Invalid value for -%c\n", c);
-		exit(-1);
-	}
-	return val;
+   float total = time_local - fp->msgtime[n];
+   float queueing = fp->msgsent[n] - fp->msgtime[n];
+   float transmission = time_local - (lastsent > fp->msgsent[n] ? lastsent : fp->msgsent[n]);
+
+   fp->latency += total;
+   hist_record(&delays[LATENCY], total);
+   hist_record(&delays[QUEUEING], queueing);
+   hist_record(&delays[TRANSMISSION], transmission);
+   hist_record(&delays[RETRANSMISSION], total - queueing - transmission);
+   ct_msg_end(cur_flow, n, fp->msgtime[n], fp->msgsent[n], lastsent, time_local);
 }
 
-void display_usage(char *filename)
+/* record the time msg number n of flow fp, len bytes long, was */
+/* passed from layer 5                                           */
+void record_msg(struct flow *fp, int n, int len)
 {
-	printf("Usage:\n %s -s Seed -w Window size -m Number of messages to simulate -l Loss -c Corruption -t Average time between messages from sender's layer5 -v Tracing\n", filename);
+   if (n >= fp->maxmsgs) {
+      fp->maxmsgs = fp->maxmsgs ? 2*fp->maxmsgs : 64;
+      fp->msgtime = (float *)realloc(fp->msgtime, fp->maxmsgs * sizeof(float));
+      fp->msgsent = (float *)realloc(fp->msgsent, fp->maxmsgs * sizeof(float));
+      fp->msgdropped = (char *)realloc(fp->msgdropped, fp->maxmsgs * sizeof(char));
+      fp->msglen = (char *)realloc(fp->msglen, fp->maxmsgs * sizeof(char));
+   }
+   fp->msgtime[n] = time_local;
+   fp->msgsent[n] = time_local;
+   fp->msgdropped[n] = 0;
+   fp->msglen[n] = len;
 }
 
-int main(int argc, char **argv)
+/* msg number msgno of a flow: a string of the same letter */
+void make_msg(int flow, int msgno, struct msg *m)
 {
-   struct event *eventptr;
-   struct msg  msg2give;
-   struct pkt  pkt2give;
-   
-   int i,j;
-   char c; 
-  
-   int opt;
-   int seed;
+   int i, len = flows[flow].msglen[msgno];
 
-   //Check for number of arguments
-   if(argc != 15){
-   		fprintf(stderr, "Missing arguments!\n");
-		display_usage(argv[0]);
-		return -1;
+   if (transferspec != NULL) {
+      transfer_fill(flow, msgno, m);   /* a piece of the file */
+      return;
    }
+   for (i=0; i<20; i++)
+      m->data[i] = i < len ? 97 + msgno % 26 : 0;
+}
 
-   /* 
-    * Parse the arguments 
-    * http://www.gnu.org/software/libc/manual/html_node/Example-of-Getopt.html 
-    */
-    while((opt = getopt(argc, argv,"s:w:m:l:c:t:v:")) != -1){
-    	switch (opt){
-    		case 's':   seed = read_arg_int(opt);
-                    	break;
-            case 'w':   win_size = read_arg_int(opt);
-            			break;
-            case 'm': 	nsimmax = read_arg_int(opt);
-            			break;
-            case 'l': 	lossprob = read_arg_float(opt);
-            			break;
-            case 'c': 	corruptprob = read_arg_float(opt);
-            			break;
-            case 't': 	if((lambda = atof(optarg)) <= 0.0){
-            				fprintf(stderr, "Invalid value for -%c\n", opt);
-							exit(-1);
-            			}		
-            			break;
-            case 'v': 	TRACE = read_arg_int(opt);
-            			break;
-            case '?':   
-           	default:    fprintf(stderr, "Invalid arguments!\n");
-						display_usage(argv[0]);
-						return -1;
-       }
-    }
-  
-   init(seed);
-   A_init();
-   B_init();
-   
-   while (1) {
-        eventptr = evlist;            /* get next event to simulate */
-        if (eventptr==NULL)
-           goto terminate;
-        evlist = evlist->next;        /* remove this event from event list */
-        if (evlist!=NULL)
-           evlist->prev=NULL;
+static void usage(char *filename)
+{
+	display_usage(filename, "[-b Bottleneck rate] [-q Bottleneck queue size] [-d Sink[:args]] [-F In:Out] [-T Topology file] [-j Threads] [-r Precision] [-p Processes] [-W Warm-up time -B Branch ...] [-P Rate|rtt[:Burst] [-U]] [-C aimd] [-N] [-R Timeout] [-M Msg size] [-S Interval:File] [-X Trace file]");
+	list_sinks();
+}
+
+void trace_event(struct event *eventptr)
+{
         if (TRACE>=2) {
            printf("\nEVENT time: %f,",eventptr->evtime);
            printf("  type: %d",eventptr->evtype);
@@ -316,19 +770,36 @@ int main(int argc, char **argv)
 	       printf(", timerinterrupt  ");
              else if (eventptr->evtype==1)
                printf(", fromlayer5 ");
-             else
+             else if (eventptr->evtype==2)
 	     printf(", fromlayer3 ");
-           printf(" entity: %d\n",eventptr->eventity);
+             else if (eventptr->evtype==4)
+	     printf(", timerwheel ");
+             else
+               printf(", hoparrival ");
+           printf(" entity: %d",eventptr->eventity);
+           if (nflows > 1)
+              printf(" flow: %d",eventptr->evflow);
+           printf("\n");
            }
-        time_local = eventptr->evtime;        /* update time to next event time */
-        if (nsim==nsimmax)
-	  break;                        /* all done with simulation */
+}
+
+/* simulate event eventptr, which is at time_local */
+void handle_event(struct event *eventptr)
+{
+   struct msg  msg2give;
+   struct pkt  pkt2give;
+   struct flow *fp;
+   int i, id, entity;
+
+        cur_flow = eventptr->evflow;
+        fp = &flows[cur_flow];
         if (eventptr->evtype == FROM_LAYER5 ) {
-            generate_next_arrival();   /* set up future arrival */
+            fp->arrival_pending = 0;
+            if (!workload->backlogged)
+               generate_next_arrival(cur_flow);   /* set up future arrival */
             /* fill in msg to give with string of same letter */    
-            j = nsim % 26; 
-            for (i=0; i<20; i++)  
-               msg2give.data[i] = 97 + j;
+            record_msg(fp, fp->application, eventptr->msglen);
+            make_msg(cur_flow, fp->application, &msg2give);
             if (TRACE>2) {
                printf("          MAINLOOP: data given to student: ");
                  for (i=0; i<20; i++) 
@@ -338,15 +809,24 @@ int main(int argc, char **argv)
             nsim++;
             if (eventptr->eventity == A)
             {
+            	ct_msg_begin(cur_flow, fp->application, time_local);
+            	fp->application += 1;
             	A_application += 1;
+            	update_queue(fp, 1);
             	A_output(msg2give);
-            }  
+            	if (fp->queued > fp->maxqueued)
+            	   fp->maxqueued = fp->queued;
+            }
             /*
              else
                B_output(msg2give);  
                */
+            if (workload->backlogged)
+               generate_next_arrival(cur_flow);
             }
           else if (eventptr->evtype ==  FROM_LAYER3) {
+            ct_packet_end(cur_flow, (eventptr->eventity+1) % 2,
+                          ((struct netpkt *)eventptr->pktptr)->traceid, "arrived", time_local);
             pkt2give.seqnum = eventptr->pktptr->seqnum;
             pkt2give.acknum = eventptr->pktptr->acknum;
             pkt2give.checksum = eventptr->pktptr->checksum;
@@ -356,12 +836,18 @@ int main(int argc, char **argv)
    	       A_input(pkt2give);            /* appropriate entity */
             else
             {
+            	lastsent = ((struct netpkt *)eventptr->pktptr)->sent;
             	B_transport += 1;
             	B_input(pkt2give);
             }
 	    free(eventptr->pktptr);          /* free the memory for packet */
             }
+          else if (eventptr->evtype ==  HOP_ARRIVAL) {
+            forward(eventptr->evnode, eventptr->pktptr, eventptr->eventity);
+            }
           else if (eventptr->evtype ==  TIMER_INTERRUPT) {
+            fp->timer[eventptr->eventity] = NULL;
+            ct_timer_end(cur_flow, eventptr->eventity, -1, "fired", time_local);
             if (eventptr->eventity == A) 
 	       A_timerinterrupt();
 	   		/*
@@ -369,13 +855,953 @@ int main(int argc, char **argv)
 	       B_timerinterrupt();
 	       	*/
              }
+          else if (eventptr->evtype ==  TIMER_WHEEL) {
+            part->wheelev = NULL;
+            if ((id = wheel_expire(&part->timers, time_local, &cur_flow, &entity)) >= 0) {
+               ct_timer_end(cur_flow, entity, id, "fired", time_local);
+               if (entity == A)
+                  A_timerinterrupt_id(id);
+            }
+            arm_wheel();
+            }
           else  {
 	     printf("INTERNAL PANIC: unknown event type \n");
              }
         free(eventptr);
+}
+
+/* Parallel run: each thread simulates a group of neighbouring nodes. */
+/* A window runs from the earliest event anywhere to lookahead later; */
+/* nothing sent in it can arrive before the window ends, so the nodes */
+/* can be simulated independently.  The threads meet once a window:   */
+/* each gives the earliest event of its nodes, counting the ones it   */
+/* posted, and then takes in the events posted to its nodes.          */
+struct worker {
+   pthread_t thread;
+   int   id;
+   int   first, last;      /* nodes first to last-1 are this thread's */
+   float next[2];          /* earliest event of its nodes, by window parity */
+   float end;              /* time of the first event after the run */
+   int   A_application, A_transport, B_application, B_transport;
+   int   nsim, ntolayer3, nlost, ncorrupt;
+};
+struct worker *workers;
+float firstevent;          /* time of the earliest event when the run starts */
+
+/* The threads meet at the end of every window.  Windows are short, so */
+/* rather than sleep a thread waits for the last one to arrive,        */
+/* yielding the CPU in case there are more threads than CPUs.           */
+int   arrived;             /* threads at the barrier */
+int   passed;              /* times the barrier was passed */
+
+void window_barrier()
+{
+   int gen = __atomic_load_n(&passed, __ATOMIC_ACQUIRE);
+
+   if (__atomic_add_fetch(&arrived, 1, __ATOMIC_ACQ_REL) == nthreads) {
+      __atomic_store_n(&arrived, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&passed, gen+1, __ATOMIC_RELEASE);
+      return;
+   }
+   while (__atomic_load_n(&passed, __ATOMIC_ACQUIRE) == gen)
+      sched_yield();
+}
+
+/* simulate the events at node n before time until */
+void run_partition(int n, float until)
+{
+   struct partition *p = &parts[n];
+   struct event *eventptr;
+
+   enter_node(n);
+   delays = p->delays;
+   while (evlist->count > 0 && evlist->heap[0]->evtime < until
+          && evlist->heap[0]->evtime <= cutoff) {
+      eventptr = nextevent();
+      trace_event(eventptr);
+      time_local = p->last = eventptr->evtime;
+      handle_event(eventptr);
+   }
+}
+
+void *run_worker(void *arg)
+{
+   struct worker *w = (struct worker *)arg;
+   float start = firstevent, next;
+   int i, n;
+
+   window = 1;
+   while (start != INFINITY && start <= cutoff) {
+      postmin = INFINITY;
+      for (n = w->first; n < w->last; n++)
+         run_partition(n, start + lookahead);
+      next = postmin;
+      for (n = w->first; n < w->last; n++)
+         if (parts[n].events.count > 0 && parts[n].events.heap[0]->evtime < next)
+            next = parts[n].events.heap[0]->evtime;
+      w->next[window] = next;
+      window_barrier();
+      for (n = w->first; n < w->last; n++)
+         take_posted(n);
+      start = INFINITY;
+      for (i = 0; i < nthreads; i++)
+         if (workers[i].next[window] < start)
+            start = workers[i].next[window];
+      window ^= 1;
+   }
+   w->end = start;
+   w->A_application = A_application;
+   w->A_transport = A_transport;
+   w->B_application = B_application;
+   w->B_transport = B_transport;
+   w->nsim = nsim;
+   w->ntolayer3 = ntolayer3;
+   w->nlost = nlost;
+   w->ncorrupt = ncorrupt;
+   return NULL;
+}
+
+void run_parallel()
+{
+   int i, n;
+
+   /* what the flows posted as they started */
+   firstevent = INFINITY;
+   for (n = 0; n < topo->nnodes; n++) {
+      take_posted(n);
+      if (parts[n].events.count > 0 && parts[n].events.heap[0]->evtime < firstevent)
+         firstevent = parts[n].events.heap[0]->evtime;
+   }
+
+   workers = (struct worker *)calloc(nthreads, sizeof(struct worker));
+   arrived = passed = 0;
+   for (i = 0; i < nthreads; i++) {
+      workers[i].id = i;
+      workers[i].first = i * topo->nnodes / nthreads;
+      workers[i].last = (i+1) * topo->nnodes / nthreads;
+      if (i > 0)
+         pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]);
+   }
+   run_worker(&workers[0]);
+   for (i = 1; i < nthreads; i++) {
+      pthread_join(workers[i].thread, NULL);
+      A_application += workers[i].A_application;
+      A_transport += workers[i].A_transport;
+      B_application += workers[i].B_application;
+      B_transport += workers[i].B_transport;
+      nsim += workers[i].nsim;
+      ntolayer3 += workers[i].ntolayer3;
+      nlost += workers[i].nlost;
+      ncorrupt += workers[i].ncorrupt;
+   }
+   delays = alldelays;
+   for (n = 0; n < topo->nnodes; n++)
+      for (i = 0; i < NDELAYS; i++)
+         hist_merge(&delays[i], &parts[n].delays[i]);
+
+   /* stop at the next event, as the sequential loop does */
+   time_local = workers[0].end;
+   if (time_local == INFINITY) {
+      time_local = 0;
+      for (n = 0; n < topo->nnodes; n++)
+         if (parts[n].last > time_local)
+            time_local = parts[n].last;
+   }
+   free(workers);
+   evlist = &mainlist;
+   rng = NULL;
+   part = NULL;
+}
+
+/* Replications: with -r the simulator forks independent runs, each   */
+/* seeded differently, until the 95% confidence intervals on the       */
+/* throughput and the average latency are within the given fraction   */
+/* of their means.  Results are taken in seed order, so the number of */
+/* replications used does not depend on which runs finish first.      */
+#define MINREPS 5
+#define MAXREPS 1000
+struct replication {
+   double throughput;
+   double latency;
+};
+float precision = 0;       /* target half-width of the intervals, 0 for one run */
+int   nprocs = 0;          /* replications run at once */
+int   repfd = -1;          /* where a replication writes its result */
+
+/* 97.5% point of Student's t distribution with df degrees of freedom */
+double student_t(int df)
+{
+   static const double t[30] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+   double z = 1.959964;
+
+   if (df <= 30)
+      return t[df-1];
+   /* Cornish-Fisher expansion about the normal */
+   return z + (z*z*z + z)/(4*df) + (5*pow(z,5) + 16*z*z*z + 3*z)/(96.0*df*df);
+}
+
+/* half-width of the 95% confidence interval of n values */
+double half_width(double sum, double sumsq, int n)
+{
+   double mean = sum/n, var = (sumsq - n*mean*mean)/(n-1);
+
+   return var > 0 ? student_t(n-1) * sqrt(var/n) : 0;
+}
+
+/* Run replications until the intervals are narrow enough and report */
+/* them.  Returns only in a child, with the seed it should run.      */
+int replicate(int seed)
+{
+   struct replication *results = (struct replication *)malloc(MAXREPS * sizeof(struct replication));
+   pid_t *pids = (pid_t *)malloc(MAXREPS * sizeof(pid_t));
+   int *fds = (int *)malloc(MAXREPS * sizeof(int));
+   char *have = (char *)calloc(MAXREPS, sizeof(char));
+   double sum[2] = {0, 0}, sumsq[2] = {0, 0}, hw[2] = {0, 0};
+   int launched = 0, running = 0, n = 0, done = 0, status, fd[2], k;
+   pid_t pid;
+
+   fflush(stdout);
+   while (1) {
+      while (!done && running < nprocs && launched < MAXREPS) {
+         if (pipe(fd) < 0 || (pid = fork()) < 0) {
+            perror("fork");
+            exit(-1);
+         }
+         if (pid == 0) {
+            close(fd[0]);
+            repfd = fd[1];
+            freopen("/dev/null", "w", stdout);   /* only the result is wanted */
+            return seed + launched;
+         }
+         close(fd[1]);
+         fds[launched] = fd[0];
+         pids[launched++] = pid;
+         running++;
+      }
+      if (running == 0)
+         break;
+
+      if ((pid = wait(&status)) < 0)
+         break;
+      for (k = 0; k < launched && pids[k] != pid; k++)
+         ;
+      if (k == launched)
+         continue;
+      running--;
+      pids[k] = 0;
+      if (!done) {
+         if (read(fds[k], &results[k], sizeof(struct replication)) != sizeof(struct replication)) {
+            fprintf(stderr, "Replication %d (seed %d) failed\n", k, seed + k);
+            exit(-1);
+         }
+         have[k] = 1;
+      }
+      close(fds[k]);
+
+      /* take the results that are next in seed order */
+      while (!done && n < launched && have[n]) {
+         sum[0] += results[n].throughput;
+         sumsq[0] += results[n].throughput * results[n].throughput;
+         sum[1] += results[n].latency;
+         sumsq[1] += results[n].latency * results[n].latency;
+         n++;
+         if (n < MINREPS)
+            continue;
+         hw[0] = half_width(sum[0], sumsq[0], n);
+         hw[1] = half_width(sum[1], sumsq[1], n);
+         if ((hw[0] <= precision * sum[0]/n && hw[1] <= precision * sum[1]/n) || n == MAXREPS) {
+            done = 1;
+            for (k = 0; k < launched; k++)
+               if (pids[k] != 0)
+                  kill(pids[k], SIGKILL);
+         }
+      }
+   }
+
+   if (n < MINREPS) {
+      fprintf(stderr, "Replications stopped after %d runs\n", n);
+      exit(-1);
+   }
+   if (hw[0] > precision * sum[0]/n || hw[1] > precision * sum[1]/n)
+      printf("Warning: intervals still wider than %f of the means after %d replications\n", precision, n);
+   printf("[PA2]Replications: %d[/PA2]\n", n);
+   printf("[PA2]Throughput: %f +- %f packets/time units (95%% confidence)[/PA2]\n", sum[0]/n, hw[0]);
+   printf("[PA2]Average latency: %f +- %f time units (95%% confidence)[/PA2]\n", sum[1]/n, hw[1]);
+   exit(0);
+}
+
+/* send the result of this replication back to the parent */
+void report_replication()
+{
+   struct replication r;
+   double latency = 0;
+   int delivered = 0, i;
+
+   for (i=0; i<nflows; i++) {
+      latency += flows[i].latency;
+      delivered += flows[i].delivered;
+   }
+   r.throughput = time_local > 0 ? B_application/time_local : 0.0;
+   r.latency = delivered > 0 ? latency/delivered : 0.0;
+   if (write(repfd, &r, sizeof(r)) != sizeof(r))
+      exit(-1);
+   exit(0);
+}
+
+/* Branches: with -W the run is simulated once up to the warm-up time */
+/* and then forked, and each -B branch carries on from that state     */
+/* with its own parameters.  A branch is a list like "l=0.2,t=15" of  */
+/*   l  loss probability of every link                                */
+/*   c  corruption probability                                        */
+/*   t  average time between msgs from layer 5                        */
+/*   b  bottleneck rate of every link                                 */
+/*   m  number of msgs to simulate in all                             */
+/* Statistics cover the whole run, warm-up included, so a branch that */
+/* changes nothing reports exactly what a single run would.           */
+struct branch {
+   const char *spec;
+   float lossprob, corruptprob, lambda, rate;   /* < 0 to keep */
+   int   nsimmax;                               /* 0 to keep */
+};
+struct branch *branches = NULL;
+int   nbranches = 0;
+float warmup = -1;         /* time to fork the branches at, < 0 for none */
+
+/* add the branch described by spec, 0 on success */
+int add_branch(const char *spec)
+{
+   struct branch *b;
+   char *copy = strdup(spec), *item, *save, *end;
+   float value;
+
+   branches = (struct branch *)realloc(branches, (nbranches+1) * sizeof(struct branch));
+   b = &branches[nbranches++];
+   b->spec = spec;
+   b->lossprob = b->corruptprob = b->lambda = b->rate = -1;
+   b->nsimmax = 0;
+   for (item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+      if (item[0] == '\0' || item[1] != '=')
+         goto bad;
+      value = strtof(item+2, &end);
+      if (end == item+2 || *end != '\0' || value < 0)
+         goto bad;
+      switch (item[0]) {
+         case 'l':   if (value > 1) goto bad;
+                     b->lossprob = value;
+                     break;
+         case 'c':   if (value > 1) goto bad;
+                     b->corruptprob = value;
+                     break;
+         case 't':   if (value <= 0) goto bad;
+                     b->lambda = value;
+                     break;
+         case 'b':   b->rate = value;
+                     break;
+         case 'm':   if (value < 1) goto bad;
+                     b->nsimmax = (int)value;
+                     break;
+         default:    goto bad;
+      }
+   }
+   free(copy);
+   return 0;
+
+bad:
+   free(copy);
+   return -1;
+}
+
+/* switch the simulation to the parameters of branch b, 0 on success */
+int apply_branch(struct branch *b)
+{
+   int i;
+
+   if (b->nsimmax > 0) {
+      if (b->nsimmax <= nsim) {
+         fprintf(stderr, "Branch %s: %d msgs were already simulated during warm-up\n", b->spec, nsim);
+         return -1;
+      }
+      nsimmax = b->nsimmax;
+      cutoff = INFINITY;     /* the last msg is still to come */
+   }
+   for (i = 0; i < topo->nlinks; i++) {
+      if (b->lossprob >= 0)
+         topo->links[i].lossprob = b->lossprob;
+      if (b->rate >= 0)
+         topo->links[i].rate = b->rate;
+   }
+   if (b->lossprob >= 0)
+      lossprob = b->lossprob;
+   if (b->corruptprob >= 0)
+      corruptprob = b->corruptprob;
+   if (b->lambda > 0) {
+      /* msgs already on the event list keep their times */
+      lambda = b->lambda;
+      set_lambda(lambda);
+   }
+   return 0;
+}
+
+/* Fork the branches from the current state, nprocs at a time, and */
+/* print their reports in order.  Returns only in a branch.        */
+void run_branches()
+{
+   FILE **out = (FILE **)malloc(nbranches * sizeof(FILE *));
+   int *status = (int *)malloc(nbranches * sizeof(int));
+   pid_t *pids = (pid_t *)calloc(nbranches, sizeof(pid_t));
+   int launched = 0, running = 0, i, k, st, c;
+   pid_t pid;
+
+   fflush(stdout);
+   while (launched < nbranches || running > 0) {
+      while (launched < nbranches && running < nprocs) {
+         if ((out[launched] = tmpfile()) == NULL || (pid = fork()) < 0) {
+            perror("fork");
+            exit(-1);
+         }
+         if (pid == 0) {
+            /* the branch reports into its own file */
+            dup2(fileno(out[launched]), STDOUT_FILENO);
+            if (apply_branch(&branches[launched]) != 0)
+               exit(-1);
+            nbranches = 0;
+            return;
+         }
+         pids[launched++] = pid;
+         running++;
+      }
+      if ((pid = wait(&st)) < 0)
+         break;
+      for (k = 0; k < launched && pids[k] != pid; k++)
+         ;
+      if (k < launched) {
+         status[k] = st;
+         running--;
+      }
+   }
+
+   for (i = 0; i < nbranches; i++) {
+      printf("[PA2]Branch %d: %s at time %f[/PA2]\n", i, branches[i].spec, time_local);
+      if (!WIFEXITED(status[i]) || WEXITSTATUS(status[i]) != 0)
+         printf("Branch %d failed\n", i);
+      rewind(out[i]);
+      while ((c = getc(out[i])) != EOF)
+         putchar(c);
+      printf("\n");
+   }
+   exit(0);
+}
+
+/* Pacing: with -P Rate[:Burst] the senders pace their packets with a */
+/* token bucket of Burst tokens (1 by default) that gains Rate tokens  */
+/* per time unit; a Rate of "rtt" sends a window per RTT estimate.     */
+/* With -U the run forks an unpaced twin of itself, so that the report */
+/* can show what the pacing gained.                                     */
+struct outcome {
+   double throughput;
+   int    lost;            /* packets lost on a link or dropped at a bottleneck */
+};
+float pace_rate = 0;       /* packets per time unit, PACE_RTT, or 0 for no pacing */
+int   pace_burst = 1;      /* packets that may be sent back to back */
+int   congestion = CC_NONE; /* -C: how the senders adapt their windows */
+int   nacks = 0;           /* -N: receivers NACK gaps */
+float basetimeout = 0;     /* -R: senders' timeout, 0 for the protocol's own */
+int   msgsize = 20;        /* -M: bytes used in each msg from layer 5 */
+int   compare_unpaced = 0; /* -U: fork the unpaced twin */
+int   twinfd = -1;         /* the twin writes its outcome here, the paced run reads it */
+int   twin = 0;            /* this is the unpaced twin */
+
+/* fork the unpaced twin; returns in both */
+void fork_twin()
+{
+   int fd[2];
+   pid_t pid;
+
+   fflush(stdout);
+   if (pipe(fd) < 0 || (pid = fork()) < 0) {
+      perror("fork");
+      exit(-1);
+   }
+   if (pid == 0) {
+      close(fd[0]);
+      twinfd = fd[1];
+      twin = 1;
+      pace_rate = 0;
+      freopen("/dev/null", "w", stdout);   /* only the outcome is wanted */
+      sink = find_sink("count");           /* and any files are the paced run's */
+      sink->init(NULL, nflows);
+      return;
+   }
+   close(fd[1]);
+   twinfd = fd[0];
+}
+
+/* The twin sends its outcome to the paced run, which reports its own */
+/* against it                                                          */
+void report_pacing()
+{
+   struct outcome mine, unpaced;
+   int i;
+
+   mine.throughput = time_local > 0 ? B_application/time_local : 0.0;
+   mine.lost = nlost;
+   for (i = 0; i < topo->nlinks; i++)
+      mine.lost += topo->links[i].ndropped;
+   if (twin) {
+      if (write(twinfd, &mine, sizeof(mine)) != sizeof(mine))
+         exit(-1);
+      exit(0);
+   }
+   if (read(twinfd, &unpaced, sizeof(unpaced)) != sizeof(unpaced)) {
+      printf("Warning: the unpaced run failed\n");
+      return;
+   }
+   wait(NULL);
+   printf("[PA2]Pacing: throughput %f packets/time units against %f unpaced (%+f%%), %d packets lost against %d unpaced[/PA2]\n",
+          mine.throughput, unpaced.throughput,
+          unpaced.throughput > 0 ? 100 * (mine.throughput / unpaced.throughput - 1) : 0.0,
+          mine.lost, unpaced.lost);
+}
+
+#define REQUIRED_OPTS "swmlctv"
+
+/* Sampling (-S): the state of every flow at each multiple of the      */
+/* interval, taken just before the first event at or after it.  When   */
+/* no event falls between two multiples nothing changed in between, so */
+/* only the last is sampled.                                            */
+const char *samplespec = NULL; /* Interval:File, NULL for no sampling */
+const char *chromefile = NULL; /* -X: file for a Chrome trace, NULL for none */
+float nextsample = 0;      /* time of the next sample */
+
+void take_samples()
+{
+   struct probe p;
+   long long k = (long long)floor(time_local / sampler_interval());
+   int f, n, timers = 0, saved = cur_flow;
+
+   for (n = 0; n < topo->nnodes; n++)
+      timers += parts[n].timers.count;
+   sample_begin(k, evlist->count + timers);
+   for (f=0; f<nflows; f++) {
+      cur_flow = f;
+      memset(&p, 0, sizeof p);
+      A_probe(&p);
+      B_probe(&p);
+      sample_flow(&p, flows[f].delivered);
+   }
+   cur_flow = saved;
+   nextsample = (k+1) * sampler_interval();
+}
+
+/* the A and B of every flow initialise themselves */
+void start_flows()
+{
+   for (cur_flow=0; cur_flow<nflows; cur_flow++) {
+      enter_node(topo->anode[cur_flow]);
+      A_init();
+      enter_node(topo->bnode[cur_flow]);
+      B_init();
+   }
+   evlist = &mainlist;
+   rng = NULL;
+}
+
+void free_event(struct event *p)
+{
+   if (p->evtype == FROM_LAYER3 || p->evtype == HOP_ARRIVAL)
+      free(p->pktptr);
+   free(p);
+}
+
+/* simulate the events on the list until the run is over: every msg  */
+/* up to the time of the nsimmax-th, and then up to the next event.   */
+/* A backlogged source passes down many msgs at the same time, so it  */
+/* stops at the nsimmax-th itself.                                    */
+void simulate()
+{
+   struct event *eventptr;
+
+   while ((eventptr = nextevent()) != NULL) {   /* get next event to simulate */
+        if (eventptr->evtype == FROM_LAYER5
+            && (eventptr->evtime > cutoff || (workload->backlogged && nsim == nsimmax))) {
+           free_event(eventptr);         /* msgs after the last are not simulated */
+           continue;
+        }
+        trace_event(eventptr);
+        time_local = eventptr->evtime;        /* update time to next event time */
+        if (time_local > cutoff) {
+           free_event(eventptr);
+	   break;                        /* all done with simulation */
         }
+        if (nbranches > 0 && time_local >= warmup)
+           run_branches();              /* carry on as each of the branches */
+        if (samplespec != NULL && !twin && time_local >= nextsample)
+           take_samples();
+        enter_node(eventptr->evnode);
+        handle_event(eventptr);
+        if (nsim == nsimmax && cutoff == INFINITY)
+           cutoff = time_local;
+        if (transferspec != NULL && transfer_done())
+           break;                       /* the whole file is across */
+        if (transferspec != NULL && A_transport > transfer_maxsent())
+           break;                       /* give up on a transfer that is not getting across */
+        }
+   rng = NULL;
+}
+
+/* the figures of the report, over all flows */
+void summarize(struct rdtsim_stats *s)
+{
+   struct flow *fp;
+   int i, sent = 0, delivered = 0;
+   double tput, sumtput = 0, sumsq = 0, queuearea = 0, queuedelay = 0, latency = 0;
+
+   memset(s, 0, sizeof *s);
+   for (i=0; i<nflows; i++) {
+      fp = &flows[i];
+      update_queue(fp, 0);
+      s->dropped += fp->dropped;
+      sent += fp->sent;
+      delivered += fp->delivered;
+      queuearea += fp->queuearea;
+      queuedelay += fp->queuedelay;
+      latency += fp->latency;
+      if (fp->maxqueued > s->max_queue)
+         s->max_queue = fp->maxqueued;
+      if (fp->maxqueuedelay > s->max_queue_delay)
+         s->max_queue_delay = fp->maxqueuedelay;
+      tput = time_local > 0 ? fp->delivered/time_local : 0.0;
+      sumtput += tput;
+      sumsq += tput*tput;
+   }
+   s->A_application = A_application;
+   s->A_transport = A_transport;
+   s->B_transport = B_transport;
+   s->B_application = B_application;
+   s->time = time_local;
+   s->throughput = B_application/time_local;
+   s->avg_queue = time_local > 0 ? queuearea/time_local : 0.0;
+   s->avg_queue_delay = sent > 0 ? queuedelay/sent : 0.0;
+   s->avg_latency = delivered > 0 ? latency/delivered : 0.0;
+   s->overhead = delivered > 0 ? (double)A_transport/delivered : 0.0;
+   s->latency_p50 = hist_percentile(&delays[LATENCY], 50);
+   s->latency_p99 = hist_percentile(&delays[LATENCY], 99);
+   s->latency_max = delays[LATENCY].max;
+   s->fairness = sumsq > 0 ? sumtput*sumtput/(nflows*sumsq) : 1.0;
+}
+
+#ifdef RDTSIM_LIBRARY
+/* free what the last run left behind, so that the next starts afresh */
+void reset()
+{
+   struct event *eventptr;
+   struct flow *fp;
+   int i;
+
+   evlist = &mainlist;
+   while ((eventptr = nextevent()) != NULL)
+      free_event(eventptr);
+   for (i=0; parts != NULL && i<topo->nnodes; i++)
+      free(parts[i].timers.timers);
+   free(parts);
+   parts = NULL;
+   free(flowrng);
+   free(flowrngstate);
+   flowrng = NULL;
+   flowrngstate = NULL;
+   for (i=0; flows != NULL && i<nflows; i++) {
+      fp = &flows[i];
+      free(fp->msgtime);
+      free(fp->msgsent);
+      free(fp->msgdropped);
+      free(fp->msglen);
+      free(fp->arrivals);
+   }
+   free(flows);
+   flows = NULL;
+   for (i=0; i<NDELAYS; i++) {
+      free(alldelays[i].counts);
+      memset(&alldelays[i], 0, sizeof alldelays[i]);
+   }
+   if (topo != NULL)
+      free_topology(topo);
+   topo = NULL;
+   A_application = A_transport = B_application = B_transport = 0;
+   nsim = 0;
+   time_local = 0;
+   lastsent = 0;
+   cur_flow = 0;
+}
+
+/* in rdtsim.cpp: make the protocol called name the one A_output() and */
+/* the rest call; 0 on success                                         */
+int select_protocol(const char *name);
+
+int rdtsim_run(const struct rdtsim_config *c, struct rdtsim_stats *s)
+{
+   if (c->window < 1 || c->nmsgs < 1 || !(c->lambda > 0) || c->nflows < 0 || !(c->timeout >= 0)
+       || !(c->loss >= 0 && c->loss <= 1) || !(c->corrupt >= 0 && c->corrupt <= 1)
+       || c->protocol == NULL || select_protocol(c->protocol) != 0)
+      return -1;
+   reset();
+   TRACE = 0;
+   win_size = c->window;
+   lossprob = c->loss;
+   corruptprob = c->corrupt;
+   lambda = c->lambda;
+   nsimmax = c->nmsgs;
+   nflows = c->nflows > 0 ? c->nflows : 1;
+   basetimeout = c->timeout;
+   workload = find_workload(wlspec);
+   sink = find_sink("count");
+   if (workload->init(NULL, lambda, nflows) != 0 || sink->init(NULL, nflows) != 0)
+      return -1;
+   topo = default_topology(nflows, lossprob, 0, 0);
+
+   init(c->seed);
+   start_flows();
+   simulate();
+   summarize(s);
+   return 0;
+}
+#endif
+
+#ifndef RDTSIM_LIBRARY
+int main(int argc, char **argv)
+{
+   struct flow *fp;
+   struct rdtsim_stats stats;
+   double tput;
+   
+   int i;
+  
+   int opt;
+   int seed;
+   int given = 0;              /* bit set for each required option seen */
+   struct timespec started, stopped;
+   const char *wlarg;
+   const char *sinkspec = "count";
 
-terminate:
+   /* 
+    * Parse the arguments 
+    * http://www.gnu.org/software/libc/manual/html_node/Example-of-Getopt.html 
+    */
+    while((opt = getopt(argc, argv,"s:w:m:l:c:t:v:a:d:F:n:b:q:T:j:r:p:W:B:P:UC:NR:M:S:X:")) != -1){
+    	switch (opt){
+    		case 's':   seed = read_arg_int(opt);
+                    	break;
+            case 'w':   win_size = read_arg_int(opt);
+            			break;
+            case 'm': 	nsimmax = read_arg_int(opt);
+            			break;
+            case 'l': 	lossprob = read_arg_float(opt);
+            			break;
+            case 'c': 	corruptprob = read_arg_float(opt);
+            			break;
+            case 't': 	if((lambda = atof(optarg)) <= 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}		
+            			break;
+            case 'v': 	TRACE = read_arg_int(opt);
+            			break;
+            case 'a': 	if((workload = find_workload(optarg)) == NULL){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			wlspec = optarg;
+            			break;
+            case 'd': 	if((sink = find_sink(optarg)) == NULL){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			sinkspec = optarg;
+            			break;
+            case 'F': 	transferspec = optarg;
+            			break;
+            case 'n': 	if((nflows = read_arg_int(opt)) < 1){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'b': 	if((bottleneck_rate = atof(optarg)) < 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'q': 	queue_limit = read_arg_int(opt);
+            			break;
+            case 'T': 	topofile = optarg;
+            			break;
+            case 'j': 	if((nthreads = read_arg_int(opt)) < 1){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'r': 	if((precision = atof(optarg)) <= 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'p': 	if((nprocs = read_arg_int(opt)) < 1){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'W': 	if((warmup = atof(optarg)) < 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'B': 	if(add_branch(optarg) != 0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'P': 	if(parse_pacing(optarg, &pace_rate, &pace_burst) != 0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'U': 	compare_unpaced = 1;
+            			break;
+            case 'C': 	if(strcmp(optarg, "aimd") != 0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			congestion = CC_AIMD;
+            			break;
+            case 'N': 	nacks = 1;
+            			break;
+            case 'R': 	if((basetimeout = atof(optarg)) <= 0.0){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			break;
+            case 'M': 	if((msgsize = read_arg_int(opt)) < 1 || msgsize > 20){
+            				fprintf(stderr, "Invalid value for -%c\n", opt);
+							exit(-1);
+            			}
+            			set_msg_size(msgsize);
+            			break;
+            case 'S': 	samplespec = optarg;
+            			break;
+            case 'X': 	chromefile = optarg;
+            			break;
+            case '?':   
+           	default:    fprintf(stderr, "Invalid arguments!\n");
+						usage(argv[0]);
+						return -1;
+       }
+       if (strchr(REQUIRED_OPTS, opt) != NULL)
+          given |= 1 << (strchr(REQUIRED_OPTS, opt) - REQUIRED_OPTS);
+    }
+
+   //Check that all required arguments were given
+   if(given != (1 << strlen(REQUIRED_OPTS)) - 1 || optind != argc){
+   		fprintf(stderr, "Missing arguments!\n");
+		usage(argv[0]);
+		return -1;
+   }
+
+   if (transferspec != NULL) {
+      if (workload != NULL || sink != NULL || msgsize != 20) {
+         fprintf(stderr, "-F can not be combined with -a, -d or -M\n");
+         exit(-1);
+      }
+      if (transfer_open(transferspec, nflows) != 0)
+         exit(-1);
+      workload = &transfer_workload;
+      sink = &transfer_sink;
+      nsimmax = -1;        /* run until the whole file is across */
+   }
+   if (workload == NULL)
+      workload = find_workload(wlspec);
+   wlarg = strchr(wlspec, ':');
+   if (workload->init(wlarg ? wlarg+1 : NULL, lambda, nflows) != 0)
+      exit(-1);
+   if (sink == NULL)
+      sink = find_sink(sinkspec);
+   wlarg = strchr(sinkspec, ':');
+   if (sink->init(wlarg ? wlarg+1 : NULL, nflows) != 0)
+      exit(-1);
+  
+   if (topofile != NULL)
+      topo = load_topology(topofile, nflows);
+   else
+      topo = default_topology(nflows, lossprob, bottleneck_rate, queue_limit);
+   if (topo == NULL)
+      exit(-1);
+
+   if (nthreads > 0) {
+      if (workload->backlogged) {
+         fprintf(stderr, "Workload %s can not be run in parallel\n", workload->name);
+         exit(-1);
+      }
+      lookahead = INFINITY;
+      for (i=0; i<topo->nlinks; i++)
+         if (topo->links[i].mindelay < lookahead)
+            lookahead = topo->links[i].mindelay;
+      if (lookahead <= 0) {
+         fprintf(stderr, "Parallel runs need every link to have a minimum delay above 0\n");
+         exit(-1);
+      }
+      if (nthreads > topo->nnodes)
+         nthreads = topo->nnodes;
+   }
+
+   if ((warmup >= 0) != (nbranches > 0)) {
+      fprintf(stderr, "-W and -B must be given together\n");
+      exit(-1);
+   }
+   if (compare_unpaced && (pace_rate == 0 || nbranches > 0 || precision > 0 || transferspec != NULL)) {
+      fprintf(stderr, "-U needs -P, and can not be combined with -r, -B or -F\n");
+      exit(-1);
+   }
+   if (nbranches > 0 && (nthreads > 0 || precision > 0)) {
+      fprintf(stderr, "Branches can not be combined with -j or -r\n");
+      exit(-1);
+   }
+   if ((samplespec != NULL || chromefile != NULL) && (nthreads > 0 || precision > 0 || nbranches > 0)) {
+      fprintf(stderr, "-S and -X can not be combined with -j, -r or -B\n");
+      exit(-1);
+   }
+   if (nprocs == 0)
+      nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+   if (precision > 0) {
+      TRACE = 0;           /* the replications would interleave their traces */
+      seed = replicate(seed);
+   }
+   else if (compare_unpaced)
+      fork_twin();
+   if (samplespec != NULL && !twin && sampler_open(samplespec, nflows) != 0)
+      exit(-1);
+   if (chromefile != NULL && !twin && ct_open(chromefile, nflows) != 0)
+      exit(-1);
+
+   init(seed);
+   start_flows();
+   clock_gettime(CLOCK_MONOTONIC, &started);
+   
+   if (nthreads > 0)
+      run_parallel();
+   else
+      simulate();
+
+   clock_gettime(CLOCK_MONOTONIC, &stopped);
+   if (nbranches > 0) {
+      fprintf(stderr, "The run ended at time %f, before the warm-up time %f: no branch ran\n", time_local, warmup);
+      exit(-1);
+   }
+   sampler_close();
+   ct_close();
+   if (repfd >= 0)
+      report_replication();
+   if (twin)
+      report_pacing();
    //Do NOT change any of the following printfs
    printf(" Simulator terminated at time %f\n after sending %d msgs from layer5\n",time_local,nsim);
 
@@ -386,8 +1812,58 @@ terminate:
    printf("[PA2]%d packets received at the Application layer of Receiver B[/PA2]\n", B_application);
    printf("[PA2]Total time: %f time units[/PA2]\n", time_local);
    printf("[PA2]Throughput: %f packets/time units[/PA2]\n", B_application/time_local);
+
+   summarize(&stats);
+   if (nflows > 1)
+      for (i=0; i<nflows; i++) {
+         fp = &flows[i];
+         tput = time_local > 0 ? fp->delivered/time_local : 0.0;
+         printf("[PA2]Flow %d: %d msgs from layer5, %d msgs delivered, throughput %f packets/time units, average latency %f time units[/PA2]\n",
+                i, fp->application, fp->delivered, tput, fp->delivered > 0 ? fp->latency/fp->delivered : 0.0);
+      }
+   printf("[PA2]Messages dropped at Sender A: %d[/PA2]\n", stats.dropped);
+   printf("[PA2]Average queue depth at Sender A: %f msgs[/PA2]\n", stats.avg_queue);
+   printf("[PA2]Maximum queue depth at Sender A: %d msgs[/PA2]\n", stats.max_queue);
+   printf("[PA2]Average queueing delay at Sender A: %f time units[/PA2]\n", stats.avg_queue_delay);
+   printf("[PA2]Maximum queueing delay at Sender A: %f time units[/PA2]\n", stats.max_queue_delay);
+   printf("[PA2]Average latency: %f time units[/PA2]\n", stats.avg_latency);
+   printf("[PA2]Overhead: %f packets sent by A per msg delivered[/PA2]\n", stats.overhead);
+   for (i=0; i<NDELAYS; i++)
+      printf("[PA2]%s: p50 %f, p90 %f, p99 %f, p99.9 %f, max %f time units[/PA2]\n",
+             delaynames[i], hist_percentile(&delays[i], 50), hist_percentile(&delays[i], 90),
+             hist_percentile(&delays[i], 99), hist_percentile(&delays[i], 99.9), delays[i].max);
+   printf("[PA2]Jain's fairness index: %f[/PA2]\n", stats.fairness);
+   if (topofile != NULL || bottleneck_rate > 0)
+      for (i=0; i<topo->nlinks; i++)
+         printf("[PA2]Link %d->%d: %d packets sent, %d dropped at bottleneck, maximum queue %d packets[/PA2]\n",
+                topo->links[i].from, topo->links[i].to, topo->links[i].nsent,
+                topo->links[i].ndropped, topo->links[i].maxqlen);
+   if (congestion != CC_NONE) {
+      double area = 0, last = 0;
+
+      for (i=0; i<nflows; i++) {
+         fp = &flows[i];
+         area += fp->cwndarea + (double)fp->cwnd * (time_local - fp->cwndtime);
+         last += fp->cwnd;
+      }
+      printf("[PA2]Congestion window, averaged over the flows: %f packets over time, %f at the end[/PA2]\n",
+             time_local > 0 ? area/(nflows*time_local) : 0.0, last/nflows);
+   }
+   if (transferspec != NULL) {
+      double wall = (stopped.tv_sec - started.tv_sec) + (stopped.tv_nsec - started.tv_nsec) / 1e9;
+      printf("[PA2]Goodput: %f bytes/time unit, %f bytes/second of wall-clock time[/PA2]\n",
+             time_local > 0 ? transfer_bytes() / time_local : 0.0, wall > 0 ? transfer_bytes() / wall : 0.0);
+   }
+   if (twinfd >= 0)
+      report_pacing();
+   sink->report();
+   if (transferspec != NULL && !transfer_done()) {
+      fprintf(stderr, "The file transfer did not finish: gave up after %d packets from A\n", A_transport);
+      return -1;
+   }
    return 0;
 }
+#endif
 
 
 /********************* EVENT HANDLINE ROUTINES *******/
@@ -422,11 +1898,10 @@ terminate:
 
 void printevlist()
 {
-  struct event *q;
   int i;
   printf("--------------\nEvent List Follows:\n");
-  for(q = evlist; q!=NULL; q=q->next) {
-    printf("Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
+  for(i = 0; i < evlist->count; i++) {
+    printf("Event time: %f, type: %d entity: %d flow: %d\n",evlist->heap[i]->evtime,evlist->heap[i]->evtype,evlist->heap[i]->eventity,evlist->heap[i]->evflow);
     }
   printf("--------------\n");
 }
@@ -439,30 +1914,19 @@ void printevlist()
 void stoptimer(int AorB)
  //AorB;  /* A or B is trying to stop timer */
 {
- struct event *q,*qold;
+ struct event *q = flows[cur_flow].timer[AorB];
 
  if (TRACE>2)
     printf("          STOP TIMER: stopping timer at %f\n",time_local);
-/* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
- for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
-       /* remove this event */
-       if (q->next==NULL && q->prev==NULL)
-             evlist=NULL;         /* remove first and only event on list */
-          else if (q->next==NULL) /* end of list - there is one in front */
-             q->prev->next = NULL;
-          else if (q==evlist) { /* front of list - there must be event after */
-             q->next->prev=NULL;
-             evlist = q->next;
-             }
-           else {     /* middle of list */
-             q->next->prev = q->prev;
-             q->prev->next =  q->next;
-             }
-       free(q);
-       return;
-     }
-  printf("Warning: unable to cancel your timer. It wasn't running.\n");
+ if (q == NULL) {
+    printf("Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+ }
+ /* remove this event */
+ removeevent(q);
+ flows[cur_flow].timer[AorB] = NULL;
+ free(q);
+ ct_timer_end(cur_flow, AorB, -1, "stopped", time_local);
 }
 
 
@@ -471,16 +1935,13 @@ void starttimer(int AorB,float increment)
 
 {
 
- struct event *q;
  struct event *evptr;
  ////char *malloc();
 
  if (TRACE>2)
     printf("          START TIMER: starting timer at %f\n",time_local);
  /* be nice: check to see if timer is already started, if so, then  warn */
-/* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
-   for (q=evlist; q!=NULL ; q = q->next)  
-    if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
+ if (flows[cur_flow].timer[AorB] != NULL) {
       printf("Warning: attempt to start a timer that is already started\n");
       return;
       }
@@ -490,40 +1951,110 @@ void starttimer(int AorB,float increment)
    evptr->evtime =  time_local + increment;
    evptr->evtype =  TIMER_INTERRUPT;
    evptr->eventity = AorB;
+   evptr->evflow = cur_flow;
+   evptr->evnode = entity_node(cur_flow, AorB);
+   flows[cur_flow].timer[AorB] = evptr;
    insertevent(evptr);
+   ct_timer_begin(cur_flow, AorB, -1, time_local, increment);
 } 
 
+/* start one of AorB's logical timers; returns its id */
+int starttimer_id(int AorB, float increment)
+{
+ int id;
 
-/************************** TOLAYER3 ***************/
-void tolayer3(int AorB,struct pkt packet)
+ if (TRACE>2)
+    printf("          START TIMER: starting timer at %f\n",time_local);
+ id = wheel_add(&part->timers, time_local + increment, cur_flow, AorB);
+ arm_wheel();
+ ct_timer_begin(cur_flow, AorB, id, time_local, increment);
+ return id;
+}
+
+/* cancel logical timer id of AorB before it goes off */
+void stoptimer_id(int AorB, int id)
 {
- struct pkt *mypktptr;
- struct event *evptr,*q;
- ////char *malloc();
- float lastime, x, jimsrand();
- int i;
+ if (TRACE>2)
+    printf("          STOP TIMER: stopping timer %d at %f\n",id,time_local);
+ if (!wheel_cancel(&part->timers, id)) {
+    printf("Warning: unable to cancel timer %d. It wasn't running.\n",id);
+    return;
+ }
+ arm_wheel();
+ ct_timer_end(cur_flow, AorB, id, "stopped", time_local);
+}
 
 
- ntolayer3++;
+/* queue a packet at the bottleneck of link l; returns the time */
+/* it leaves the bottleneck, or -1 if the queue is full          */
+float enter_bottleneck(struct link *l)
+{
+ float depart;
+
+ if (l->rate <= 0)
+    return time_local;
+ if (l->qlimit > 0) {
+    /* forget packets that have left the queue */
+    while (l->qlen > 0 && l->departures[l->qhead] <= time_local) {
+       l->qhead = (l->qhead+1) % l->qlimit;
+       l->qlen--;
+    }
+    if (l->qlen == l->qlimit) {
+       l->ndropped++;
+       return -1;
+    }
+ }
+ depart = (l->busyuntil > time_local ? l->busyuntil : time_local) + 1/l->rate;
+ l->busyuntil = depart;
+ if (l->qlimit > 0) {
+    l->departures[(l->qhead + l->qlen) % l->qlimit] = depart;
+    l->qlen++;
+    if (l->qlen > l->maxqlen)
+       l->maxqlen = l->qlen;
+ }
+ return depart;
+}
 
- if(AorB == 0) A_transport += 1;
+/* node that entity AorB of flow f sits on */
+int entity_node(int f, int AorB)
+{
+ return AorB == A ? topo->anode[f] : topo->bnode[f];
+}
+
+/* send packet p, now at node n, one hop further towards entity AorB */
+/* of the current flow; p is freed if the packet is lost             */
+void forward(int n, struct pkt *mypktptr, int AorB)
+{
+ struct event *evptr;
+ struct link *l;
+ float lastime;
+ int i;
+
+ if ((l = route(topo, n, entity_node(cur_flow, AorB))) == NULL) {
+      if (TRACE>0)
+	printf("          TOLAYER3: packet dropped, no route from node %d\n", n);
+      ct_packet_end(cur_flow, (AorB+1) % 2, ((struct netpkt *)mypktptr)->traceid,
+                    "no route", time_local);
+      free(mypktptr);
+      return;
+    }
+ l->nsent++;
+ if ((lastime = enter_bottleneck(l)) < 0) {
+      if (TRACE>0)
+	printf("          TOLAYER3: packet dropped at bottleneck\n");
+      ct_packet_end(cur_flow, (AorB+1) % 2, ((struct netpkt *)mypktptr)->traceid,
+                    "dropped at bottleneck", time_local);
+      free(mypktptr);
+      return;
+    }
 
  /* simulate losses: */
- if (jimsrand() < lossprob)  {
-      nlost++;
-      if (TRACE>0)    
-	printf("          TOLAYER3: packet being lost\n");
+ if (lose_packet(l->lossprob))  {
+      ct_packet_end(cur_flow, (AorB+1) % 2, ((struct netpkt *)mypktptr)->traceid, "lost", time_local);
+      free(mypktptr);
       return;
     }  
 
-/* make a copy of the packet student just gave me since he/she may decide */
-/* to do something with the packet after we return back to him/her */ 
- mypktptr = (struct pkt *)malloc(sizeof(struct pkt));
- mypktptr->seqnum = packet.seqnum;
- mypktptr->acknum = packet.acknum;
- mypktptr->checksum = packet.checksum;
- for (i=0; i<20; i++)
-    mypktptr->payload[i] = packet.payload[i];
  if (TRACE>2)  {
    printf("          TOLAYER3: seq: %d, ack %d, check: %d ", mypktptr->seqnum,
 	  mypktptr->acknum,  mypktptr->checksum);
@@ -532,45 +2063,76 @@ void tolayer3(int AorB,struct pkt packet)
     printf("\n");
    }
 
-/* create future event for arrival of packet at the other side */
+/* create future event for arrival of packet at the next node */
   evptr = (struct event *)malloc(sizeof(struct event));
-  evptr->evtype =  FROM_LAYER3;   /* packet will pop out from layer3 */
-  evptr->eventity = (AorB+1) % 2; /* event occurs at other entity */
+  if (l->to == entity_node(cur_flow, AorB))
+     evptr->evtype =  FROM_LAYER3;   /* packet will pop out from layer3 */
+  else
+     evptr->evtype =  HOP_ARRIVAL;   /* packet will be forwarded again */
+  evptr->eventity = AorB;
+  evptr->evflow = cur_flow;
+  evptr->evnode = l->to;
   evptr->pktptr = mypktptr;       /* save ptr to my copy of packet */
 /* finally, compute the arrival time of packet at the other end.
-   medium can not reorder, so make sure packet arrives between 1 and 10
-   time units after the latest arrival time of packets
-   currently in the medium on their way to the destination */
- lastime = time_local;
-/* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next) */
- for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==FROM_LAYER3  && q->eventity==evptr->eventity) ) 
-      lastime = q->evtime;
- evptr->evtime =  lastime + 1 + 9*jimsrand();
+   a link can not reorder.  the default medium makes sure packet
+   arrives between 1 and 10 time units after the latest arrival time
+   of packets currently in the medium; other links only make sure it
+   does not arrive before them */
+ if (l->serial && l->lastarrival > lastime)
+    lastime = l->lastarrival;
+ evptr->evtime =  lastime + l->mindelay + l->jitter*jimsrand();
+ if (evptr->evtime < l->lastarrival)
+    evptr->evtime = l->lastarrival;
+ l->lastarrival = evptr->evtime;
  
 
 
  /* simulate corruption: */
- if (jimsrand() < corruptprob)  {
-    ncorrupt++;
-    if ( (x = jimsrand()) < .75)
-       mypktptr->payload[0]='Z';   /* corrupt payload */
-      else if (x < .875)
-       mypktptr->seqnum = 999999;
-      else
-       mypktptr->acknum = 999999;
-    if (TRACE>0)    
-	printf("          TOLAYER3: packet being corrupted\n");
-    }  
+ if (corrupt_packet(mypktptr, corruptprob))
+    ct_packet_mark(cur_flow, (AorB+1) % 2, ((struct netpkt *)mypktptr)->traceid, "corrupted", time_local);
 
   if (TRACE>2)  
      printf("          TOLAYER3: scheduling arrival on other side\n");
-  insertevent(evptr);
+  if (nthreads > 0)
+     post_event(l->to, evptr);
+  else
+     insertevent(evptr);
+}
+
+/************************** TOLAYER3 ***************/
+void tolayer3(int AorB,struct pkt packet)
+{
+ struct pkt *mypktptr;
+ struct netpkt *np;
+ ////char *malloc();
+ int i;
+
+
+ ntolayer3++;
+
+ if(AorB == 0) A_transport += 1;
+
+/* make a copy of the packet student just gave me since he/she may decide */
+/* to do something with the packet after we return back to him/her */
+ np = (struct netpkt *)malloc(sizeof(struct netpkt));
+ np->sent = time_local;
+ np->traceid = ct_packet_begin(cur_flow, AorB, packet.seqnum, packet.acknum, time_local);
+ mypktptr = &np->pkt;
+ mypktptr->seqnum = packet.seqnum;
+ mypktptr->acknum = packet.acknum;
+ mypktptr->checksum = packet.checksum;
+ for (i=0; i<20; i++)
+    mypktptr->payload[i] = packet.payload[i];
+
+ /* the packet crosses the network towards the other entity */
+ forward(entity_node(cur_flow, AorB), mypktptr, (AorB+1) % 2);
 } 
 
 void tolayer5(int AorB,char *datasent)
 {
-  
+  struct flow *fp = &flows[cur_flow];
+  /* in a parallel run A may be adding msgs while B reads these */
+  int nmsgs = nthreads > 0 ? fp->narrivals : fp->application;
   int i;  
   if (TRACE>2) {
      printf("          TOLAYER5: data received: ");
@@ -578,7 +2140,19 @@ void tolayer5(int AorB,char *datasent)
         printf("%c",datasent[i]);
      printf("\n");
    }
-  if(AorB == 1) B_application += 1;
+  if(AorB == 1) {
+     B_application += 1;
+     /* msgs are delivered in order, so this is the oldest undelivered msg */
+     while (fp->nextdeliver < nmsgs && fp->msgdropped[fp->nextdeliver])
+        fp->nextdeliver++;
+     if (fp->nextdeliver < nmsgs) {
+        sink->deliver(cur_flow, fp->nextdeliver, datasent);
+        record_delivery(fp, fp->nextdeliver++);
+     }
+     else
+        sink->deliver(cur_flow, -1, datasent);
+     fp->delivered++;
+  }
 }
 
 int getwinsize()
@@ -589,4 +2163,93 @@ int getwinsize()
 float get_sim_time()
 {
 	return time_local;
-}
\ No newline at end of file
+}
+
+float get_pace_rate()
+{
+	return pace_rate;
+}
+
+int get_pace_burst()
+{
+	return pace_burst;
+}
+
+int get_congestion_control()
+{
+	return congestion;
+}
+
+int get_nacks()
+{
+	return nacks;
+}
+
+float get_timeout()
+{
+	return basetimeout;
+}
+
+int get_msg_size()
+{
+	return msgsize;
+}
+
+/* called by a sender whose window changed size, under -C */
+void window_changed(int AorB, float window)
+{
+	struct flow *fp = &flows[cur_flow];
+
+	fp->cwndarea += (double)fp->cwnd * (time_local - fp->cwndtime);
+	fp->cwnd = window;
+	fp->cwndtime = time_local;
+}
+
+int get_flow()
+{
+	return cur_flow;
+}
+
+int get_num_flows()
+{
+	return nflows;
+}
+
+/* called by students routine when a msg from layer 5 is first given to layer 3 */
+void msg_sent(int AorB)
+{
+  struct flow *fp = &flows[cur_flow];
+  float delay;
+
+  if (AorB != A)
+     return;
+  while (fp->next < fp->application && fp->msgdropped[fp->next])
+     fp->next++;
+  if (fp->next >= fp->application) {
+     printf("Warning: msg_sent called with no msg waiting to be sent\n");
+     return;
+  }
+  delay = time_local - fp->msgtime[fp->next];
+  fp->queuedelay += delay;
+  if (delay > fp->maxqueuedelay)
+     fp->maxqueuedelay = delay;
+  fp->msgsent[fp->next] = time_local;
+  fp->next++;
+  fp->sent++;
+  update_queue(fp, -1);
+  if (workload->backlogged)
+     generate_next_arrival(cur_flow);
+}
+
+/* called by students routine when the msg just passed from layer 5 is discarded */
+void msg_dropped(int AorB)
+{
+  struct flow *fp = &flows[cur_flow];
+
+  if (AorB != A || fp->application == 0)
+     return;
+  fp->msgdropped[fp->application-1] = 1;
+  ct_msg_dropped(cur_flow, fp->application-1, time_local);
+  fp->dropped++;
+  update_queue(fp, -1);
+}
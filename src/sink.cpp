@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../include/sink.h"
+
+#define MSGSIZE 20
+
+/*****************************************************************
+ Sinks for msgs delivered to layer 5 of B:
+  - count:     nothing beyond the simulator's own counts (the original)
+  - verify:    checks every flow delivers exactly the msgs A was given,
+               in order, by hashing both streams as they go
+  - file:      writes each flow's msgs to a file, "file:out" writes
+               out, or out.0, out.1, ... when there are several flows
+ Each sink keeps separate state for every flow.
+******************************************************************/
+
+static int count_init(const char *arg, int nflows)
+{
+   return 0;
+}
+
+static void count_deliver(int flow, int msgno, const char *data)
+{
+}
+
+static void count_report()
+{
+}
+
+/**************************** VERIFY ****************************/
+/* FNV-1a over the delivered bytes and over the bytes A was given.  */
+/* The hashes are equal exactly as long as the streams are, so one  */
+/* compare per msg finds the first bad one without keeping any msg. */
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME  1099511628211ull
+
+struct verify_flow {
+   uint64_t delivered, expected; /* hashes of the two streams so far */
+   int   nverified;              /* msgs delivered while they agreed */
+   int   firstbad;               /* msgno where they parted, -1 if not */
+};
+static struct verify_flow *verify;
+static int nverify;
+
+static uint64_t fnv(uint64_t h, const char *data)
+{
+   int i;
+
+   for (i = 0; i < MSGSIZE; i++)
+      h = (h ^ (unsigned char)data[i]) * FNV_PRIME;
+   return h;
+}
+
+static int verify_init(const char *arg, int nflows)
+{
+   int i;
+
+   nverify = nflows;
+   verify = (struct verify_flow *)malloc(nflows * sizeof(struct verify_flow));
+   for (i = 0; i < nflows; i++) {
+      verify[i].delivered = verify[i].expected = FNV_OFFSET;
+      verify[i].nverified = 0;
+      verify[i].firstbad = -1;
+   }
+   return 0;
+}
+
+static void verify_deliver(int flow, int msgno, const char *data)
+{
+   struct verify_flow *v = &verify[flow];
+   struct msg m;
+
+   if (v->firstbad >= 0)
+      return;                /* the streams stay different from here on */
+   if (msgno < 0) {
+      v->firstbad = v->nverified;
+      return;
+   }
+   make_msg(flow, msgno, &m);
+   v->expected = fnv(v->expected, m.data);
+   v->delivered = fnv(v->delivered, data);
+   if (v->delivered == v->expected)
+      v->nverified++;
+   else
+      v->firstbad = msgno;
+}
+
+static void verify_report()
+{
+   int i, nverified = 0, nbad = 0;
+
+   for (i = 0; i < nverify; i++) {
+      nverified += verify[i].nverified;
+      if (verify[i].firstbad >= 0) {
+         nbad++;
+         printf("[PA2]Flow %d: delivered data differs from msg %d on[/PA2]\n", i, verify[i].firstbad);
+      }
+   }
+   printf("[PA2]Integrity: %d msgs verified, %d flows with bad data[/PA2]\n", nverified, nbad);
+}
+
+/**************************** FILE ******************************/
+static FILE **files;
+static int nfiles;
+
+static int file_init(const char *arg, int nflows)
+{
+   char *name;
+   int i;
+
+   if (arg == NULL || arg[0] == '\0') {
+      fprintf(stderr, "The file sink needs a file name\n");
+      return -1;
+   }
+   nfiles = nflows;
+   files = (FILE **)malloc(nflows * sizeof(FILE *));
+   name = (char *)malloc(strlen(arg) + 16);
+   for (i = 0; i < nflows; i++) {
+      if (nflows == 1)
+         strcpy(name, arg);
+      else
+         sprintf(name, "%s.%d", arg, i);
+      if ((files[i] = fopen(name, "wb")) == NULL) {
+         fprintf(stderr, "Unable to open %s\n", name);
+         free(name);
+         return -1;
+      }
+   }
+   free(name);
+   return 0;
+}
+
+static void file_deliver(int flow, int msgno, const char *data)
+{
+   /* a msg ends at its first NUL, as layer 5 made it */
+   fwrite(data, 1, strnlen(data, MSGSIZE), files[flow]);
+}
+
+static void file_report()
+{
+   int i;
+
+   for (i = 0; i < nfiles; i++)
+      fclose(files[i]);
+}
+
+static struct sink sinks[] = {
+   { "count",  count_init,  count_deliver,  count_report },
+   { "verify", verify_init, verify_deliver, verify_report },
+   { "file",   file_init,   file_deliver,   file_report },
+};
+
+/* look up a sink by "name" or "name:arguments" */
+struct sink *find_sink(const char *spec)
+{
+   unsigned int i;
+   size_t n = strcspn(spec, ":");
+
+   for (i = 0; i < sizeof(sinks)/sizeof(sinks[0]); i++)
+      if (strlen(sinks[i].name) == n && strncmp(spec, sinks[i].name, n) == 0)
+         return &sinks[i];
+   return NULL;
+}
+
+void list_sinks()
+{
+   unsigned int i;
+
+   printf(" Sinks (-d):");
+   for (i = 0; i < sizeof(sinks)/sizeof(sinks[0]); i++)
+      printf(" %s", sinks[i].name);
+   printf("\n");
+}
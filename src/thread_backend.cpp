@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../include/backend.h"
+#include "../include/spsc_ring.h"
+#include "../include/workload.h"
+
+/*****************************************************************
+ THREADED BACKEND: A and B each run on a thread of their own, pinned
+ to separate cores, and exchange packets through a lock-free ring in
+ each direction.  The rings behave like the simulator's medium:
+ packets stay in order, and each one is held back until 1 to 10 time
+ units after the previous one on the ring was delivered.  A packet
+ only reaches the other side once that wall-clock time has come.  A
+ packet that would wait more than RING_MAXDELAY is dropped, so a
+ sender that outruns the ring can not build an ever longer queue.
+******************************************************************/
+
+#define RING_MAXDELAY 1000 /* time units a packet may be held back */
+
+struct ring ring[2];       /* ring[A] carries packets from A to B */
+thread_local double lastarrival; /* latest due time put on this thread's ring */
+int   done;                /* set by A once every msg is delivered or dropped */
+int   delivered;           /* msgs B has passed to layer 5 so far */
+
+/* what B counted, handed back when its thread ends */
+struct counts {
+   int B_transport, B_application, ntolayer3, nlost, ncorrupt, nfull;
+};
+
+void send_packet(int AorB, struct wire *w)
+{
+   double t = now();
+
+   if (lastarrival > t)
+      t = lastarrival;
+   w->due = t + 1 + 9*jimsrand();
+   if (w->due - now() > RING_MAXDELAY) {
+      nfull++;
+      return;
+   }
+   if (!ring_put(&ring[AorB], w)) {
+      nfull++;
+      return;
+   }
+   lastarrival = w->due;
+}
+
+/* deliver the packets towards AorB that are due; returns how many */
+int receive(int AorB)
+{
+   struct wire *w;
+   double t = now();
+   int n = 0;
+
+   while ((w = ring_peek(&ring[1-AorB])) != NULL && w->due <= t) {
+      cur_flow = w->flow;
+      if (AorB == A)
+         A_input(w->pkt);
+      else {
+         B_transport += 1;
+         B_input(w->pkt);
+      }
+      ring_pop(&ring[1-AorB]);
+      n++;
+   }
+   return n;
+}
+
+/* run the calling thread on core n only */
+void pin(int n)
+{
+   cpu_set_t set;
+
+   CPU_ZERO(&set);
+   CPU_SET(n % sysconf(_SC_NPROCESSORS_ONLN), &set);
+   pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+void *run_B(void *arg)
+{
+   struct counts *c = (struct counts *)arg;
+
+   pin(1);
+   seed_random(B);
+   while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+      run_deadlines();
+      if (receive(B) > 0)
+         __atomic_store_n(&delivered, B_application, __ATOMIC_RELEASE);
+      else
+         sched_yield();
+   }
+   c->B_transport = B_transport;
+   c->B_application = B_application;
+   c->ntolayer3 = ntolayer3;
+   c->nlost = nlost;
+   c->ncorrupt = ncorrupt;
+   c->nfull = nfull;
+   return NULL;
+}
+
+void run_A()
+{
+   double idle = 0;
+
+   while (1) {
+      run_deadlines();
+      B_application = __atomic_load_n(&delivered, __ATOMIC_ACQUIRE);
+      if (finished() || out_of_time())
+         return;
+      if (receive(A) > 0)
+         idle = now();
+      else if (now() - idle > 5e6 / usec_per_unit) {
+         fprintf(stderr, "No packets for 5 seconds, giving up\n");
+         return;
+      }
+      else
+         sched_yield();
+   }
+}
+
+int main(int argc, char **argv)
+{
+   struct counts c;
+   pthread_t thread;
+   double elapsed;
+
+   setup(argc, argv);
+   start_clock();
+   pin(0);
+   if (pthread_create(&thread, NULL, run_B, &c) != 0) {
+      fprintf(stderr, "Unable to start the thread of B\n");
+      exit(-1);
+   }
+   start_arrivals();
+   run_A();
+   elapsed = now();
+   __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+   pthread_join(thread, NULL);
+
+   B_application = c.B_application;
+   B_transport = c.B_transport;
+   ntolayer3 += c.ntolayer3;
+   nlost += c.nlost;
+   ncorrupt += c.ncorrupt;
+   nfull += c.nfull;
+   report(elapsed);
+   return 0;
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/timerwheel.h"
+
+#define FAR      WHEEL_LEVELS                      /* level of the far list */
+#define MAXINDEX (1 << WHEEL_INDEXBITS)
+#define GENMASK  ((1 << (31 - WHEEL_INDEXBITS)) - 1)
+
+static long long tick_of(float when)
+{
+   return (long long)floor((double)when * WHEEL_TICKS);
+}
+
+/* put timer i on the list its time belongs to, seen from w->now */
+static void place(struct wheel *w, int i)
+{
+   struct wtimer *t = &w->timers[i];
+   long long tick = tick_of(t->when);
+   unsigned long long differ;
+   int level = 0, *head;
+
+   if (tick < w->now)
+      tick = w->now;
+   differ = tick ^ w->now;
+   while (level < WHEEL_LEVELS && (differ >> (WHEEL_BITS*(level+1))) != 0)
+      level++;
+   t->level = level;
+   t->slot = level == FAR ? 0 : (tick >> (WHEEL_BITS*level)) & (WHEEL_SLOTS-1);
+   head = &w->head[t->level][t->slot];
+   t->prev = -1;
+   t->next = *head;
+   if (*head >= 0)
+      w->timers[*head].prev = i;
+   *head = i;
+   w->occupied[level] |= 1ULL << t->slot;
+}
+
+static void take_off(struct wheel *w, int i)
+{
+   struct wtimer *t = &w->timers[i];
+   int *head = &w->head[t->level][t->slot];
+
+   if (t->prev >= 0)
+      w->timers[t->prev].next = t->next;
+   else
+      *head = t->next;
+   if (t->next >= 0)
+      w->timers[t->next].prev = t->prev;
+   if (*head < 0)
+      w->occupied[t->level] &= ~(1ULL << t->slot);
+}
+
+/* take every timer off a list and place it again */
+static void cascade(struct wheel *w, int level, int slot)
+{
+   int i = w->head[level][slot], next;
+
+   w->head[level][slot] = -1;
+   w->occupied[level] &= ~(1ULL << slot);
+   for (; i >= 0; i = next) {
+      next = w->timers[i].next;
+      place(w, i);
+   }
+}
+
+/* move the wheel on to tick; no timer may go off before it */
+static void advance(struct wheel *w, long long tick)
+{
+   long long old = w->now;
+   int level;
+
+   if (tick <= old)
+      return;
+   w->now = tick;
+   if ((tick >> (WHEEL_BITS*WHEEL_LEVELS)) != (old >> (WHEEL_BITS*WHEEL_LEVELS)))
+      cascade(w, FAR, 0);
+   for (level = WHEEL_LEVELS-1; level > 0; level--)
+      if ((tick >> (WHEEL_BITS*level)) != (old >> (WHEEL_BITS*level)))
+         cascade(w, level, (tick >> (WHEEL_BITS*level)) & (WHEEL_SLOTS-1));
+}
+
+/* first list in use, and its slot: the levels and their slots are in */
+/* time order.  Returns its level, -1 if no timer is running.         */
+static int first_list(struct wheel *w, int *slot)
+{
+   int level;
+
+   for (level = 0; level <= WHEEL_LEVELS; level++)
+      if (w->occupied[level] != 0) {
+         *slot = __builtin_ctzll(w->occupied[level]);
+         return level;
+      }
+   return -1;
+}
+
+/* earliest timer on a list */
+static int earliest(struct wheel *w, int level, int slot)
+{
+   int i, best = -1;
+   struct wtimer *t;
+
+   for (i = w->head[level][slot]; i >= 0; i = t->next) {
+      t = &w->timers[i];
+      if (best < 0 || t->when < w->timers[best].when
+          || (t->when == w->timers[best].when && t->seq < w->timers[best].seq))
+         best = i;
+   }
+   return best;
+}
+
+/* tick the list at level, slot begins at */
+static long long list_start(struct wheel *w, int level, int slot)
+{
+   int shift = WHEEL_BITS*level;
+
+   if (level == FAR)
+      return tick_of(w->timers[earliest(w, FAR, 0)].when);
+   return (w->now >> (shift + WHEEL_BITS) << (shift + WHEEL_BITS)) | (long long)slot << shift;
+}
+
+int wheel_add(struct wheel *w, float when, int flow, int entity)
+{
+   struct wtimer *t;
+   int i, n;
+
+   if (w->size == 0) {
+      for (i = 0; i <= WHEEL_LEVELS; i++)
+         for (n = 0; n < WHEEL_SLOTS; n++)
+            w->head[i][n] = -1;
+      w->freelist = -1;
+   }
+   if (w->freelist < 0) {
+      n = w->size ? 2*w->size : 64;
+      if (n > MAXINDEX) {
+         fprintf(stderr, "More than %d timers running\n", MAXINDEX);
+         exit(1);
+      }
+      w->timers = (struct wtimer *)realloc(w->timers, n * sizeof(struct wtimer));
+      for (i = n-1; i >= w->size; i--) {
+         w->timers[i].id = -1;
+         w->timers[i].gen = 0;
+         w->timers[i].next = w->freelist;
+         w->freelist = i;
+      }
+      w->size = n;
+   }
+   i = w->freelist;
+   t = &w->timers[i];
+   w->freelist = t->next;
+   t->gen = (t->gen + 1) & GENMASK;
+   t->id = i | t->gen << WHEEL_INDEXBITS;
+   t->when = when;
+   t->flow = flow;
+   t->entity = entity;
+   t->seq = w->seq++;
+   place(w, i);
+   w->count++;
+   return t->id;
+}
+
+static void release(struct wheel *w, int i)
+{
+   struct wtimer *t = &w->timers[i];
+
+   take_off(w, i);
+   t->id = -1;
+   t->next = w->freelist;
+   w->freelist = i;
+   w->count--;
+}
+
+int wheel_cancel(struct wheel *w, int id)
+{
+   int i = id & (MAXINDEX-1);
+
+   if (id < 0 || i >= w->size || w->timers[i].id != id)
+      return 0;
+   release(w, i);
+   return 1;
+}
+
+float wheel_next(struct wheel *w)
+{
+   int level, slot;
+
+   if ((level = first_list(w, &slot)) < 0)
+      return INFINITY;
+   if (level > 0)
+      return (float)list_start(w, level, slot) / WHEEL_TICKS;
+   return w->timers[earliest(w, 0, slot)].when;
+}
+
+int wheel_expire(struct wheel *w, float t, int *flow, int *entity)
+{
+   int level, slot, i, id;
+   long long start;
+
+   /* spread the lists the wheel has reached over the levels below */
+   while ((level = first_list(w, &slot)) > 0) {
+      start = list_start(w, level, slot);
+      if ((float)start / WHEEL_TICKS > t)
+         return -1;
+      advance(w, start);
+   }
+   if (level < 0)
+      return -1;
+   i = earliest(w, 0, slot);
+   if (w->timers[i].when > t)
+      return -1;
+   advance(w, tick_of(w->timers[i].when));
+   id = w->timers[i].id;
+   *flow = w->timers[i].flow;
+   *entity = w->timers[i].entity;
+   release(w, i);
+   return id;
+}
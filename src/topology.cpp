@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/topology.h"
+
+static void add_link(struct topology *t, int from, int to, float mindelay,
+                     float jitter, float lossprob, float rate, int qlimit)
+{
+   struct link *l;
+
+   t->links = (struct link *)realloc(t->links, (t->nlinks+1) * sizeof(struct link));
+   l = &t->links[t->nlinks++];
+   memset(l, 0, sizeof(struct link));
+   l->from = from;
+   l->to = to;
+   l->mindelay = mindelay;
+   l->jitter = jitter;
+   l->lossprob = lossprob;
+   l->rate = rate;
+   l->qlimit = qlimit;
+   if (qlimit > 0)
+      l->departures = (float *)malloc(qlimit * sizeof(float));
+   if (from >= t->nnodes)
+      t->nnodes = from+1;
+   if (to >= t->nnodes)
+      t->nnodes = to+1;
+}
+
+static int find_link(struct topology *t, int from, int to)
+{
+   int i;
+
+   for (i = 0; i < t->nlinks; i++)
+      if (t->links[i].from == from && t->links[i].to == to)
+         return i;
+   return -1;
+}
+
+/* fill in the routes not given explicitly with fewest-hop paths */
+static void complete_routes(struct topology *t)
+{
+   int *queue = (int *)malloc(t->nnodes * sizeof(int));
+   int *first = (int *)malloc(t->nnodes * sizeof(int));
+   int n, d, i, head, tail, u;
+
+   for (n = 0; n < t->nnodes; n++) {
+      /* breadth-first search from n, remembering the first link taken */
+      for (d = 0; d < t->nnodes; d++)
+         first[d] = -2;
+      first[n] = -1;
+      head = tail = 0;
+      queue[tail++] = n;
+      while (head < tail) {
+         u = queue[head++];
+         for (i = 0; i < t->nlinks; i++) {
+            if (t->links[i].from != u || first[t->links[i].to] != -2)
+               continue;
+            first[t->links[i].to] = (u == n) ? i : first[u];
+            queue[tail++] = t->links[i].to;
+         }
+      }
+      for (d = 0; d < t->nnodes; d++)
+         if (t->nexthop[n*t->nnodes+d] == -1 && first[d] >= 0)
+            t->nexthop[n*t->nnodes+d] = first[d];
+   }
+   free(queue);
+   free(first);
+}
+
+static void set_flows(struct topology *t, int nflows)
+{
+   int i;
+
+   t->nflows = nflows;
+   t->anode = (int *)malloc(nflows * sizeof(int));
+   t->bnode = (int *)malloc(nflows * sizeof(int));
+   for (i = 0; i < nflows; i++) {
+      t->anode[i] = 0;
+      t->bnode[i] = t->nnodes-1;
+   }
+}
+
+static void alloc_routes(struct topology *t)
+{
+   int i;
+
+   t->nexthop = (int *)malloc(t->nnodes * t->nnodes * sizeof(int));
+   for (i = 0; i < t->nnodes * t->nnodes; i++)
+      t->nexthop[i] = -1;
+}
+
+struct topology *default_topology(int nflows, float lossprob, float rate, int qlimit)
+{
+   struct topology *t = (struct topology *)calloc(1, sizeof(struct topology));
+
+   /* medium delays packets 1 to 10 time units */
+   add_link(t, 0, 1, 1, 9, lossprob, rate, qlimit);
+   add_link(t, 1, 0, 1, 9, lossprob, rate, qlimit);
+   t->links[0].serial = t->links[1].serial = 1;
+   alloc_routes(t);
+   complete_routes(t);
+   set_flows(t, nflows);
+   return t;
+}
+
+void free_topology(struct topology *t)
+{
+   int i;
+
+   for (i = 0; i < t->nlinks; i++)
+      free(t->links[i].departures);
+   free(t->links);
+   free(t->nexthop);
+   free(t->anode);
+   free(t->bnode);
+   free(t);
+}
+
+/* the routes from node n lead to node d without visiting a node twice */
+static int reaches(struct topology *t, int n, int d)
+{
+   int hops;
+
+   for (hops = 0; n != d; hops++) {
+      if (hops == t->nnodes-1 || t->nexthop[n*t->nnodes+d] < 0)
+         return 0;
+      n = t->links[t->nexthop[n*t->nnodes+d]].to;
+   }
+   return 1;
+}
+
+struct topology *load_topology(const char *file, int nflows)
+{
+   struct topology *t;
+   FILE *fp;
+   char line[256], word[16], delay[64], flow[16];
+   int lineno = 0, pass, u, v, h, a, b, f, qlimit, n;
+   float mindelay, maxdelay, lossprob, rate;
+
+   if ((fp = fopen(file, "r")) == NULL) {
+      fprintf(stderr, "Unable to open topology file %s\n", file);
+      return NULL;
+   }
+   t = (struct topology *)calloc(1, sizeof(struct topology));
+
+   /* links first, so that routes and flows can be checked against them */
+   for (pass = 0; pass < 2; pass++) {
+      rewind(fp);
+      lineno = 0;
+      if (pass == 1) {
+         alloc_routes(t);
+         set_flows(t, nflows);
+      }
+      while (fgets(line, sizeof(line), fp) != NULL) {
+         lineno++;
+         if ((n = sscanf(line, "%15s", word)) < 1 || word[0] == '#')
+            continue;
+         if (strcmp(word, "link") == 0) {
+            if (pass == 1)
+               continue;
+            qlimit = 0;
+            if (sscanf(line, "%*s %d %d %63s %f %f %d", &u, &v, delay, &lossprob, &rate, &qlimit) < 5
+                || u < 0 || v < 0 || u == v || lossprob < 0 || lossprob > 1 || rate < 0 || qlimit < 0)
+               goto bad;
+            if (sscanf(delay, "%f:%f", &mindelay, &maxdelay) == 1)
+               maxdelay = mindelay;
+            if (mindelay < 0 || maxdelay < mindelay)
+               goto bad;
+            add_link(t, u, v, mindelay, maxdelay-mindelay, lossprob, rate, qlimit);
+            add_link(t, v, u, mindelay, maxdelay-mindelay, lossprob, rate, qlimit);
+         }
+         else if (pass == 0)
+            continue;
+         else if (strcmp(word, "route") == 0) {
+            if (sscanf(line, "%*s %d %d %d", &u, &v, &h) != 3
+                || u < 0 || u >= t->nnodes || v < 0 || v >= t->nnodes
+                || (h = find_link(t, u, h)) < 0)
+               goto bad;
+            t->nexthop[u*t->nnodes+v] = h;
+         }
+         else if (strcmp(word, "flow") == 0) {
+            if (sscanf(line, "%*s %15s %d %d", flow, &a, &b) != 3
+                || a < 0 || a >= t->nnodes || b < 0 || b >= t->nnodes || a == b)
+               goto bad;
+            if (strcmp(flow, "*") == 0) {
+               for (f = 0; f < nflows; f++) {
+                  t->anode[f] = a;
+                  t->bnode[f] = b;
+               }
+            }
+            else if ((f = atoi(flow)) >= 0 && f < nflows) {
+               t->anode[f] = a;
+               t->bnode[f] = b;
+            }
+         }
+         else
+            goto bad;
+      }
+      if (t->nnodes < 2) {
+         fprintf(stderr, "Topology %s needs at least one link\n", file);
+         goto fail;
+      }
+   }
+   fclose(fp);
+   complete_routes(t);
+
+   for (f = 0; f < nflows; f++)
+      if (!reaches(t, t->anode[f], t->bnode[f]) || !reaches(t, t->bnode[f], t->anode[f])) {
+         fprintf(stderr, "Topology %s has no route between the nodes of flow %d, or one with a loop\n", file, f);
+         free_topology(t);
+         return NULL;
+      }
+   return t;
+
+bad:
+   fprintf(stderr, "Invalid line %d in topology file %s\n", lineno, file);
+fail:
+   fclose(fp);
+   free_topology(t);
+   return NULL;
+}
+
+struct link *route(struct topology *t, int n, int d)
+{
+   int i = t->nexthop[n*t->nnodes+d];
+
+   return i < 0 ? NULL : &t->links[i];
+}
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/transfer.h"
+
+#define MSGSIZE 20
+
+static char  *input;            /* the input file, mapped */
+static long long size;          /* and its size */
+static int   nflows;
+static char  **outputs;         /* output file of each flow, mapped */
+static long long *offset;       /* bytes of the input each flow has made into msgs */
+static long long *delivered;    /* bytes each flow has written to its output */
+static int   nfinished;         /* flows that have delivered all of the input */
+
+/* create output file name as big as the input and map it at *p */
+static int map_output(const char *name, char **p)
+{
+   int fd;
+
+   if ((fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0 || ftruncate(fd, size) < 0) {
+      fprintf(stderr, "Unable to create %s\n", name);
+      if (fd >= 0)
+         close(fd);
+      return -1;
+   }
+   *p = size > 0 ? (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : NULL;
+   close(fd);
+   if (*p == MAP_FAILED) {
+      fprintf(stderr, "Unable to map %s\n", name);
+      *p = NULL;
+      return -1;
+   }
+   return 0;
+}
+
+/* undo what transfer_open() has done so far */
+static void transfer_free()
+{
+   int f;
+
+   for (f = 0; outputs != NULL && f < nflows; f++)
+      if (outputs[f] != NULL)
+         munmap(outputs[f], size);
+   if (input != NULL)
+      munmap(input, size);
+   free(outputs);
+   free(offset);
+   free(delivered);
+   input = NULL;
+   outputs = NULL;
+   offset = delivered = NULL;
+}
+
+int transfer_open(const char *spec, int n)
+{
+   char *in = strdup(spec), *out, *name = NULL;
+   struct stat st;
+   int fd, f;
+
+   if ((out = strchr(in, ':')) == NULL || out == in || out[1] == '\0') {
+      fprintf(stderr, "File transfer needs input and output files, In:Out\n");
+      goto fail;
+   }
+   *out++ = '\0';
+   if ((fd = open(in, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+      fprintf(stderr, "Unable to open %s\n", in);
+      if (fd >= 0)
+         close(fd);
+      goto fail;
+   }
+   size = st.st_size;
+   input = size > 0 ? (char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+   close(fd);
+   if (input == MAP_FAILED) {
+      fprintf(stderr, "Unable to map %s\n", in);
+      input = NULL;
+      goto fail;
+   }
+   if (size > 0)
+      madvise(input, size, MADV_SEQUENTIAL);
+
+   nflows = n;
+   outputs = (char **)calloc(nflows, sizeof(char *));
+   offset = (long long *)calloc(nflows, sizeof(long long));
+   delivered = (long long *)calloc(nflows, sizeof(long long));
+   nfinished = size > 0 ? 0 : nflows;
+   name = (char *)malloc(strlen(out) + 16);
+   for (f = 0; f < nflows; f++) {
+      if (nflows == 1)
+         strcpy(name, out);
+      else
+         sprintf(name, "%s.%d", out, f);
+      if (map_output(name, &outputs[f]) != 0)
+         goto fail;
+   }
+   free(name);
+   free(in);
+   return 0;
+
+fail:
+   transfer_free();
+   free(name);
+   free(in);
+   return -1;
+}
+
+/* msg number msgno of a flow is the 20 bytes at msgno*20 in the input */
+void transfer_fill(int flow, int msgno, struct msg *m)
+{
+   long long at = (long long)msgno * MSGSIZE;
+   int len = size - at < MSGSIZE ? size - at : MSGSIZE;
+
+   memcpy(m->data, input + at, len);
+   memset(m->data + len, 0, MSGSIZE - len);
+}
+
+int transfer_done()
+{
+   return nfinished == nflows;
+}
+
+long long transfer_bytes()
+{
+   long long total = 0;
+   int f;
+
+   for (f = 0; f < nflows; f++)
+      total += delivered[f];
+   return total;
+}
+
+long long transfer_maxsent()
+{
+   return TRANSFER_MAXSENT * nflows * ((size + MSGSIZE - 1) / MSGSIZE);
+}
+
+/* the workload: the next msg as soon as A has sent the last one */
+static int file_init(const char *arg, float lambda, int n)
+{
+   return 0;
+}
+
+static float file_next(int flow, float now, int *len)
+{
+   if (offset[flow] >= size)
+      return -1;
+   *len = size - offset[flow] < MSGSIZE ? size - offset[flow] : MSGSIZE;
+   offset[flow] += *len;
+   return 0;
+}
+
+struct workload transfer_workload = { "file", file_init, file_next, 1 };
+
+/* the sink: each msg is written where it came from */
+static int mmap_init(const char *arg, int n)
+{
+   return 0;
+}
+
+static void mmap_deliver(int flow, int msgno, const char *data)
+{
+   long long at = (long long)msgno * MSGSIZE;
+   int len;
+
+   if (msgno < 0 || at >= size)
+      return;
+   len = size - at < MSGSIZE ? size - at : MSGSIZE;
+   memcpy(outputs[flow] + at, data, len);
+   delivered[flow] += len;
+   if (delivered[flow] == size)
+      nfinished++;
+}
+
+static void mmap_report()
+{
+   int f, nbad = 0;
+
+   for (f = 0; f < nflows; f++) {
+      if (delivered[f] != size || (size > 0 && memcmp(outputs[f], input, size) != 0))
+         nbad++;
+      if (size > 0)
+         munmap(outputs[f], size);
+   }
+   printf("[PA2]File transfer: %lld bytes per flow, %d of %d outputs match the input[/PA2]\n",
+          size, nflows - nbad, nflows);
+}
+
+struct sink transfer_sink = { "mmap", mmap_init, mmap_deliver, mmap_report };
@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+
+#include "../include/rdtsim.h"
+
+/*****************************************************************
+ tune: searches the window and the timeout (-w and -R) of a protocol
+ for the pair with the best throughput on a channel, or the best one
+ whose p99 latency meets a limit (-L).  Each coordinate is searched
+ in turn, the other held, until the best pair stays put.  A search
+ narrows a bracket around the best value seen: with one or two
+ processes by golden-section, evaluating a point per step, and with
+ more by evaluating as many points as there are processes at once.
+ Every configuration runs in a child process through librdtsim, over
+ -k seeds, and the report lists the frontier of throughput against
+ p99 latency among all the configurations tried.
+******************************************************************/
+
+#define MAXPOINTS 4096
+#define MAXROUNDS 4
+#define GOLDEN    0.6180339887
+#define TSTEP     0.01     /* timeouts tried are multiples of this */
+
+struct point {
+   int    window;
+   float  timeout;
+   double throughput;      /* averaged over the seeds */
+   double p99;
+   double latency;
+};
+
+static struct rdtsim_config base;      /* the channel, as given */
+static int    nseeds = 1;              /* -k */
+static int    nprocs = 1;              /* -p */
+static double slo = 0;                 /* -L: p99 latency to meet, 0 for none */
+static struct point points[MAXPOINTS]; /* every configuration tried */
+static int    npoints = 0;
+
+/* whether a is better than b: it meets the SLO and b does not, or has */
+/* more throughput, or as much with less latency                      */
+static int better(const struct point *a, const struct point *b)
+{
+   if (slo > 0 && (a->p99 <= slo) != (b->p99 <= slo))
+      return a->p99 <= slo;
+   if (slo > 0 && a->p99 > slo)
+      return a->p99 < b->p99;
+   if (a->throughput != b->throughput)
+      return a->throughput > b->throughput;
+   return a->p99 < b->p99;
+}
+
+static struct point *find(int window, float timeout)
+{
+   int i;
+
+   for (i = 0; i < npoints; i++)
+      if (points[i].window == window && points[i].timeout == timeout)
+         return &points[i];
+   return NULL;
+}
+
+/* run a configuration over the seeds, in a child; its averages go to fd */
+static void run(const struct point *p, int fd)
+{
+   struct rdtsim_config c = base;
+   struct rdtsim_stats s;
+   struct point r = *p;
+   int k;
+
+   r.throughput = r.p99 = r.latency = 0;
+   c.window = p->window;
+   c.timeout = p->timeout;
+   for (k = 0; k < nseeds; k++) {
+      c.seed = base.seed + k;
+      if (rdtsim_run(&c, &s) != 0)
+         _exit(1);
+      r.throughput += s.throughput / nseeds;
+      r.p99 += s.latency_p99 / nseeds;
+      r.latency += s.avg_latency / nseeds;
+   }
+   if (write(fd, &r, sizeof r) != sizeof r)
+      _exit(1);
+   _exit(0);
+}
+
+/* try the configurations of want[] not tried yet, nprocs at a time */
+static void evaluate(struct point *want, int n)
+{
+   int fds[MAXPOINTS], pids[MAXPOINTS];
+   int fd[2];
+   int i, k, first = npoints, launched, running = 0, status, pid;
+
+   for (i = 0; i < n; i++)
+      if (find(want[i].window, want[i].timeout) == NULL) {
+         if (npoints == MAXPOINTS) {
+            fprintf(stderr, "More than %d configurations\n", MAXPOINTS);
+            exit(-1);
+         }
+         points[npoints++] = want[i];
+      }
+
+   fflush(stdout);
+   for (launched = first; launched < npoints || running > 0; ) {
+      while (launched < npoints && running < nprocs) {
+         if (pipe(fd) < 0 || (pid = fork()) < 0) {
+            perror("fork");
+            exit(-1);
+         }
+         if (pid == 0) {
+            close(fd[0]);
+            run(&points[launched], fd[1]);
+         }
+         close(fd[1]);
+         fds[launched] = fd[0];
+         pids[launched++] = pid;
+         running++;
+      }
+      if ((pid = wait(&status)) < 0)
+         break;
+      for (k = first; k < launched && pids[k] != pid; k++)
+         ;
+      if (k == launched)
+         continue;
+      running--;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0
+          || read(fds[k], &points[k], sizeof points[k]) != sizeof points[k]) {
+         fprintf(stderr, "The run of -w %d -R %g failed\n", points[k].window, points[k].timeout);
+         exit(-1);
+      }
+      close(fds[k]);
+   }
+}
+
+/* value i of the n+2 across [lo, hi], ends included: at the golden */
+/* section for two in between, evenly spaced for more              */
+static double section(double lo, double hi, int i, int n)
+{
+   if (i == 0 || i == n+1)
+      return i == 0 ? lo : hi;
+   if (n == 2)
+      return i == 1 ? hi - GOLDEN*(hi - lo) : lo + GOLDEN*(hi - lo);
+   return lo + (hi - lo) * i / (n+1);
+}
+
+/* search [lo, hi] for the best window (axis 0) or timeout (axis 1), */
+/* the other as in at, and return the best configuration             */
+static struct point search(int axis, double lo, double hi, struct point at)
+{
+   struct point want[MAXPOINTS];
+   double x[MAXPOINTS];
+   struct point *p, *best;
+   int n = nprocs > 2 ? nprocs : 2;
+   int i, ibest, all;
+
+   while (1) {
+      /* once the windows left are few, try them all */
+      all = axis == 0 && hi - lo <= n+1;
+      if (all)
+         n = (int)(hi - lo) - 1;
+      for (i = 0; i < n+2; i++) {
+         want[i] = at;
+         if (axis == 0)
+            want[i].window = (int)(x[i] = (int)(section(lo, hi, i, n) + 0.5));
+         else
+            want[i].timeout = (float)(x[i] = floor(section(lo, hi, i, n) / TSTEP + 0.5) * TSTEP);
+      }
+      evaluate(want, n+2);
+
+      best = NULL;
+      ibest = 0;
+      for (i = 0; i < n+2; i++) {
+         p = find(want[i].window, want[i].timeout);
+         if (best == NULL || better(p, best)) {
+            best = p;
+            ibest = i;
+         }
+      }
+      if (all || (axis == 1 && hi - lo <= 4*TSTEP))
+         return *best;
+      lo = x[ibest > 0 ? ibest-1 : 0];
+      hi = x[ibest < n+1 ? ibest+1 : n+1];
+   }
+}
+
+/* the configurations no other beats on both throughput and p99 latency, */
+/* the first of any that do equally well; points[] is sorted             */
+static void print_frontier()
+{
+   int i, j, beaten;
+   struct point *p, *q;
+
+   printf("[PA2]Frontier of throughput against p99 latency, of %d configurations:[/PA2]\n", npoints);
+   for (i = 0; i < npoints; i++) {
+      p = &points[i];
+      beaten = 0;
+      for (j = 0; j < npoints && !beaten; j++) {
+         q = &points[j];
+         beaten = q->throughput >= p->throughput && q->p99 <= p->p99
+                  && (q->throughput > p->throughput || q->p99 < p->p99 || j < i);
+      }
+      if (!beaten)
+         printf("[PA2]  -w %d -R %g: throughput %f packets/time units, latency p99 %f, average %f time units[/PA2]\n",
+                p->window, p->timeout, p->throughput, p->p99, p->latency);
+   }
+}
+
+/* parse Min:Max into lo and hi, 0 on success */
+static int parse_range(const char *spec, double *lo, double *hi)
+{
+   char *end;
+
+   *lo = strtod(spec, &end);
+   if (*end != ':')
+      return -1;
+   *hi = strtod(end+1, &end);
+   return *end != '\0' || !(*lo > 0 && *hi > *lo) ? -1 : 0;
+}
+
+static int compare_points(const void *a, const void *b)
+{
+   const struct point *p = (const struct point *)a, *q = (const struct point *)b;
+
+   if (p->throughput != q->throughput)
+      return p->throughput < q->throughput ? 1 : -1;
+   if (p->p99 != q->p99)
+      return p->p99 > q->p99 ? 1 : -1;
+   if (p->window != q->window)
+      return p->window - q->window;
+   return (p->timeout > q->timeout) - (p->timeout < q->timeout);
+}
+
+static void display_usage(const char *filename)
+{
+   printf("Usage:\n %s -l Loss -c Corruption -t Average time between messages from sender's layer5 -m Number of messages to simulate [-s Seed] [-n Flows] [-w Min:Max window] [-R Min:Max timeout] [-L p99 latency] [-k Seeds] [-p Processes] abt|gbn|sr|fec\n", filename);
+}
+
+int main(int argc, char **argv)
+{
+   double wlo = 1, whi = 64, tlo = 5, thi = 60;
+   struct point at, next;
+   int opt, round, i;
+
+   base.seed = 1;
+   base.loss = base.corrupt = -1;
+   base.lambda = 0;
+   base.nmsgs = 0;
+   while ((opt = getopt(argc, argv, "l:c:t:m:s:n:w:R:L:k:p:")) != -1) {
+      switch (opt) {
+         case 'l':   base.loss = atof(optarg);
+                     break;
+         case 'c':   base.corrupt = atof(optarg);
+                     break;
+         case 't':   base.lambda = atof(optarg);
+                     break;
+         case 'm':   base.nmsgs = atoi(optarg);
+                     break;
+         case 's':   base.seed = atoi(optarg);
+                     break;
+         case 'n':   base.nflows = atoi(optarg);
+                     break;
+         case 'w':   if (parse_range(optarg, &wlo, &whi) != 0 || wlo != (int)wlo || whi != (int)whi) {
+                        fprintf(stderr, "Invalid value for -%c\n", opt);
+                        return -1;
+                     }
+                     break;
+         case 'R':   if (parse_range(optarg, &tlo, &thi) != 0) {
+                        fprintf(stderr, "Invalid value for -%c\n", opt);
+                        return -1;
+                     }
+                     break;
+         case 'L':   if ((slo = atof(optarg)) <= 0) {
+                        fprintf(stderr, "Invalid value for -%c\n", opt);
+                        return -1;
+                     }
+                     break;
+         case 'k':   if ((nseeds = atoi(optarg)) < 1) {
+                        fprintf(stderr, "Invalid value for -%c\n", opt);
+                        return -1;
+                     }
+                     break;
+         case 'p':   if ((nprocs = atoi(optarg)) < 1 || nprocs > MAXPOINTS - 2) {
+                        fprintf(stderr, "Invalid value for -%c\n", opt);
+                        return -1;
+                     }
+                     break;
+         default:    display_usage(argv[0]);
+                     return -1;
+      }
+   }
+   if (optind != argc-1 || base.nmsgs < 1 || base.lambda <= 0
+       || base.loss < 0 || base.loss > 1 || base.corrupt < 0 || base.corrupt > 1) {
+      fprintf(stderr, "Missing arguments!\n");
+      display_usage(argv[0]);
+      return -1;
+   }
+   base.protocol = argv[optind];
+   if (strcmp(base.protocol, "abt") != 0 && strcmp(base.protocol, "gbn") != 0
+       && strcmp(base.protocol, "sr") != 0 && strcmp(base.protocol, "fec") != 0) {
+      fprintf(stderr, "No protocol %s\n", base.protocol);
+      return -1;
+   }
+   if (strcmp(base.protocol, "abt") == 0)      /* it has no window to tune */
+      wlo = whi = 1;
+
+   /* from the middle of both ranges, search each in turn */
+   at.window = (int)((wlo + whi) / 2);
+   at.timeout = (float)(floor((tlo + thi) / 2 / TSTEP + 0.5) * TSTEP);
+   for (round = 0; round < MAXROUNDS; round++) {
+      next = at;
+      if (whi > wlo)
+         next = search(0, wlo, whi, next);
+      next = search(1, tlo, thi, next);
+      if (round > 0 && next.window == at.window && next.timeout == at.timeout)
+         break;
+      at = next;
+   }
+
+   /* the best of all tried, which an earlier search may have found */
+   for (i = 0; i < npoints; i++)
+      if (better(&points[i], &at))
+         at = points[i];
+   qsort(points, npoints, sizeof points[0], compare_points);
+   print_frontier();
+   if (slo > 0 && at.p99 > slo)
+      printf("[PA2]No configuration meets a p99 latency of %f; the lowest is %f, with -w %d -R %g[/PA2]\n",
+             slo, at.p99, at.window, at.timeout);
+   else
+      printf("[PA2]Best: -w %d -R %g: throughput %f packets/time units, latency p99 %f, average %f time units[/PA2]\n",
+             at.window, at.timeout, at.throughput, at.p99, at.latency);
+   return 0;
+}
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../include/backend.h"
+
+/*****************************************************************
+ UDP BACKEND: packets travel over real UDP sockets on the loopback
+ interface:
+  - A and B each own a socket; packets carry the flow they belong to
+  - tolayer3() queues packets and sends them in batches with sendmmsg(),
+    and arriving packets are read in batches with recvmmsg()
+  - one timerfd fires for the earliest protocol timer or layer-5 arrival
+******************************************************************/
+
+#define BATCH 64           /* packets per sendmmsg()/recvmmsg() */
+#define SOCKBUF (4 << 20)  /* socket buffer size */
+
+int   nsendcalls;          /* sendmmsg() calls */
+int   nrecvcalls;          /* recvmmsg() calls */
+int   nsent;               /* packets handed to the sockets */
+int   nrecvd;              /* packets read from the sockets */
+
+int   sock[2];             /* sockets of A and B */
+int   epfd, tfd;
+double armed = -1;         /* deadline the timerfd is set for */
+
+/* packets waiting to be sent from A and B, and packets read */
+struct batch {
+   struct mmsghdr hdr[BATCH];
+   struct iovec iov[BATCH];
+   struct wire buf[BATCH];
+   int count;
+};
+struct batch out[2], in;
+
+/* set the timerfd for the earliest deadline */
+void arm_timer()
+{
+   struct itimerspec its;
+   double t, usec;
+
+   if ((t = next_deadline()) == armed)
+      return;
+   armed = t;
+   memset(&its, 0, sizeof(its));
+   if (t >= 0) {
+      /* relative to now, so the backend does not need time 0 itself */
+      usec = (t - now()) * usec_per_unit;
+      if (usec < 1)
+         usec = 1;           /* zero would disarm the timer */
+      its.it_value.tv_sec = (time_t)(usec / 1e6);
+      its.it_value.tv_nsec = (long)((usec - its.it_value.tv_sec * 1e6) * 1e3);
+   }
+   timerfd_settime(tfd, 0, &its, NULL);
+}
+
+/* send the packets batched at entity AorB */
+void flush(int AorB)
+{
+   struct batch *b = &out[AorB];
+   int done = 0, n;
+
+   while (done < b->count) {
+      n = sendmmsg(sock[AorB], &b->hdr[done], b->count - done, 0);
+      nsendcalls++;
+      if (n < 0) {
+         if (errno == EINTR)
+            continue;
+         nfull += b->count - done;   /* socket buffer is full */
+         break;
+      }
+      done += n;
+   }
+   nsent += done;
+   b->count = 0;
+}
+
+void send_packet(int AorB, struct wire *w)
+{
+   if (out[AorB].count == BATCH)
+      flush(AorB);
+   out[AorB].buf[out[AorB].count++] = *w;
+}
+
+/* read and deliver everything waiting at entity AorB */
+void receive(int AorB)
+{
+   struct wire *w;
+   int i, n;
+
+   do {
+      n = recvmmsg(sock[AorB], in.hdr, BATCH, MSG_DONTWAIT, NULL);
+      if (n <= 0)
+         return;
+      nrecvcalls++;
+      nrecvd += n;
+      for (i = 0; i < n; i++) {
+         w = &in.buf[i];
+         if (in.hdr[i].msg_len != sizeof(struct wire) || w->flow < 0 || w->flow >= nflows)
+            continue;
+         cur_flow = w->flow;
+         if (AorB == A)
+            A_input(w->pkt);
+         else {
+            B_transport += 1;
+            B_input(w->pkt);
+         }
+      }
+   } while (n == BATCH);
+}
+
+void open_sockets()
+{
+   struct sockaddr_in addr[2];
+   socklen_t len = sizeof(struct sockaddr_in);
+   struct epoll_event ev;
+   int i, size = SOCKBUF;
+
+   for (i = 0; i < 2; i++) {
+      if ((sock[i] = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)) < 0) {
+         perror("socket");
+         exit(-1);
+      }
+      setsockopt(sock[i], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+      setsockopt(sock[i], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+      memset(&addr[i], 0, sizeof(addr[i]));
+      addr[i].sin_family = AF_INET;
+      addr[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if (bind(sock[i], (struct sockaddr *)&addr[i], len) < 0
+          || getsockname(sock[i], (struct sockaddr *)&addr[i], &len) < 0) {
+         perror("bind");
+         exit(-1);
+      }
+   }
+   for (i = 0; i < 2; i++)
+      if (connect(sock[i], (struct sockaddr *)&addr[1-i], len) < 0) {
+         perror("connect");
+         exit(-1);
+      }
+
+   /* the batches point at their own buffers once and for all */
+   for (i = 0; i < BATCH; i++) {
+      out[A].iov[i].iov_base = &out[A].buf[i];
+      out[B].iov[i].iov_base = &out[B].buf[i];
+      in.iov[i].iov_base = &in.buf[i];
+      out[A].iov[i].iov_len = out[B].iov[i].iov_len = in.iov[i].iov_len = sizeof(struct wire);
+      out[A].hdr[i].msg_hdr.msg_iov = &out[A].iov[i];
+      out[B].hdr[i].msg_hdr.msg_iov = &out[B].iov[i];
+      in.hdr[i].msg_hdr.msg_iov = &in.iov[i];
+      out[A].hdr[i].msg_hdr.msg_iovlen = out[B].hdr[i].msg_hdr.msg_iovlen = in.hdr[i].msg_hdr.msg_iovlen = 1;
+   }
+
+   epfd = epoll_create1(0);
+   tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+   ev.events = EPOLLIN;
+   for (i = 0; i < 2; i++) {
+      ev.data.fd = sock[i];
+      epoll_ctl(epfd, EPOLL_CTL_ADD, sock[i], &ev);
+   }
+   ev.data.fd = tfd;
+   epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev);
+}
+
+int main(int argc, char **argv)
+{
+   struct epoll_event evs[4];
+   unsigned long long expirations;
+   int i, n, idle = 0;
+
+   setup(argc, argv);
+   open_sockets();
+   start_clock();
+   start_arrivals();
+
+   while (!finished() && !out_of_time()) {
+      run_deadlines();
+      flush(A);
+      flush(B);
+      arm_timer();
+      n = epoll_wait(epfd, evs, 4, 1000);
+      if (n == 0 && ++idle == 5) {
+         fprintf(stderr, "No packets for 5 seconds, giving up\n");
+         break;
+      }
+      if (n > 0)
+         idle = 0;
+      for (i = 0; i < n; i++) {
+         if (evs[i].data.fd == tfd) {
+            if (read(tfd, &expirations, sizeof(expirations)) > 0)
+               armed = -1;
+         }
+         else
+            receive(evs[i].data.fd == sock[A] ? A : B);
+      }
+   }
+
+   report(now());
+   printf("[PA2]Packets per sendmmsg: %f, per recvmmsg: %f[/PA2]\n",
+          nsendcalls > 0 ? (double)nsent / nsendcalls : 0.0,
+          nrecvcalls > 0 ? (double)nrecvd / nrecvcalls : 0.0);
+   return 0;
+}
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/workload.h"
+
+#define MSGSIZE 20
+
+/*****************************************************************
+ Workload generators for messages passed from layer 5 to A:
+  - uniform:   inter-arrival times uniform on [0, 2*lambda] (the original)
+  - poisson:   exponential inter-arrival times with mean lambda
+  - bursty:    on/off source, exponential ON and OFF periods, Poisson
+               arrivals during ON periods at the same long-run rate
+  - saturate:  a new msg whenever A has nothing waiting to be sent
+  - trace:     arrival times and sizes replayed from a file
+ Each generator keeps separate state for every flow.
+******************************************************************/
+
+static float mean_gap;     /* mean inter-arrival time */
+static int   msgsize = MSGSIZE; /* bytes used in each msg */
+
+/* exponential random variable with the given mean */
+static float expdist(float mean)
+{
+   float u = jimsrand();
+   if (u >= 1.0)
+      u = 0.999999;
+   return -mean * log(1.0 - u);
+}
+
+static int uniform_init(const char *arg, float lambda, int nflows)
+{
+   mean_gap = lambda;
+   return 0;
+}
+
+static float uniform_next(int flow, float now, int *len)
+{
+   *len = msgsize;
+   return mean_gap*jimsrand()*2;  /* x is uniform on [0,2*lambda] */
+                                  /* having mean of lambda        */
+}
+
+static float poisson_next(int flow, float now, int *len)
+{
+   *len = msgsize;
+   return expdist(mean_gap);
+}
+
+/**************************** BURSTY ****************************/
+static float on_mean, off_mean;   /* mean length of ON and OFF periods */
+static float *burst_end;          /* time the current ON period of each flow ends */
+
+static int bursty_init(const char *arg, float lambda, int nflows)
+{
+   int i;
+
+   mean_gap = lambda;
+   on_mean = off_mean = 10 * lambda;
+   if (arg != NULL && sscanf(arg, "%f:%f", &on_mean, &off_mean) != 2) {
+      fprintf(stderr, "bursty workload expects bursty:ON:OFF\n");
+      return -1;
+   }
+   if (on_mean <= 0.0 || off_mean < 0.0) {
+      fprintf(stderr, "Invalid ON/OFF period for bursty workload\n");
+      return -1;
+   }
+   burst_end = (float *)malloc(nflows * sizeof(float));
+   for (i = 0; i < nflows; i++)
+      burst_end[i] = -1;
+   return 0;
+}
+
+static float bursty_next(int flow, float now, int *len)
+{
+   /* arrive faster while ON so the long-run mean gap is still lambda */
+   float on_gap = mean_gap * on_mean / (on_mean + off_mean);
+   float t;
+
+   *len = msgsize;
+   if (burst_end[flow] < 0)
+      burst_end[flow] = now + expdist(on_mean);
+   t = now + expdist(on_gap);
+   while (t > burst_end[flow]) { /* skip over an OFF period */
+      t = burst_end[flow] + expdist(off_mean);
+      burst_end[flow] = t + expdist(on_mean);
+      t += expdist(on_gap);
+   }
+   return t - now;
+}
+
+/*************************** SATURATE ***************************/
+static float saturate_next(int flow, float now, int *len)
+{
+   *len = msgsize;
+   return 0;
+}
+
+/***************************** TRACE ****************************/
+/* Each line of the trace holds an absolute arrival time and,     */
+/* optionally, a size in bytes (default 20) and the flow it       */
+/* belongs to (default 0).  Sizes larger than one msg are split   */
+/* into several msgs arriving at the same time.                   */
+struct trace_record {
+   float time;
+   int size;
+};
+
+struct trace_flow {
+   struct trace_record *records;
+   int nrecords, maxrecords;
+   int pos;                       /* next record to replay */
+   int left;                      /* bytes of current record still to pass down */
+};
+static struct trace_flow *traces;
+
+static int trace_init(const char *arg, float lambda, int nflows)
+{
+   FILE *fp;
+   char line[256];
+   struct trace_flow *tf;
+   float t;
+   int size, flow, n;
+
+   if (arg == NULL || (fp = fopen(arg, "r")) == NULL) {
+      fprintf(stderr, "Unable to open trace file %s\n", arg ? arg : "");
+      return -1;
+   }
+   traces = (struct trace_flow *)calloc(nflows, sizeof(struct trace_flow));
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      if (line[0] == '#')
+         continue;
+      size = msgsize;
+      flow = 0;
+      if ((n = sscanf(line, "%f %d %d", &t, &size, &flow)) < 1 || size <= 0)
+         continue;
+      if (flow < 0 || flow >= nflows) {
+         fprintf(stderr, "Trace record for flow %d, but only %d flows\n", flow, nflows);
+         fclose(fp);
+         return -1;
+      }
+      tf = &traces[flow];
+      if (tf->nrecords == tf->maxrecords) {
+         tf->maxrecords = tf->maxrecords ? 2*tf->maxrecords : 64;
+         tf->records = (struct trace_record *)realloc(tf->records,
+                           tf->maxrecords * sizeof(struct trace_record));
+      }
+      tf->records[tf->nrecords].time = t;
+      tf->records[tf->nrecords].size = size;
+      tf->nrecords++;
+   }
+   fclose(fp);
+   return 0;
+}
+
+static float trace_next(int flow, float now, int *len)
+{
+   struct trace_flow *tf = &traces[flow];
+   struct trace_record *r;
+
+   if (tf->left <= 0) {
+      if (tf->pos == tf->nrecords)
+         return -1;
+      tf->left = tf->records[tf->pos++].size;
+   }
+   r = &tf->records[tf->pos-1];
+   *len = tf->left < msgsize ? tf->left : msgsize;
+   tf->left -= *len;
+   return r->time > now ? r->time - now : 0;
+}
+
+static struct workload workloads[] = {
+   { "uniform",  uniform_init, uniform_next,  0 },
+   { "poisson",  uniform_init, poisson_next,  0 },
+   { "bursty",   bursty_init,  bursty_next,   0 },
+   { "saturate", uniform_init, saturate_next, 1 },
+   { "trace",    trace_init,   trace_next,    0 },
+};
+
+/* change the mean time between msgs, keeping every flow's state */
+void set_lambda(float lambda)
+{
+   mean_gap = lambda;
+}
+
+/* use only the first size bytes of each msg */
+void set_msg_size(int size)
+{
+   msgsize = size;
+}
+
+/* look up a generator by "name" or "name:arguments" */
+struct workload *find_workload(const char *spec)
+{
+   unsigned int i;
+   size_t n = strcspn(spec, ":");
+
+   for (i = 0; i < sizeof(workloads)/sizeof(workloads[0]); i++)
+      if (strlen(workloads[i].name) == n && strncmp(spec, workloads[i].name, n) == 0)
+         return &workloads[i];
+   return NULL;
+}
+
+void list_workloads()
+{
+   unsigned int i;
+
+   printf(" Workloads (-a):");
+   for (i = 0; i < sizeof(workloads)/sizeof(workloads[0]); i++)
+      printf(" %s", workloads[i].name);
+   printf("\n");
+}